@@ -0,0 +1,691 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ptrace.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#define ERROR_OPEN_FILE -1
+#define ERROR_WRITE -1
+#define ERROR_READ -1
+#define ERROR_PIPE -1
+#define ERROR_FORK -1
+#define ERROR_WAIT -1
+#define ERROR_PARSE_OPTIONS -1
+#define ERROR_GENERATE -1
+#define ERROR_RUN_ENGINE -1
+
+#define SUCCESS_PARSE_OPTIONS 0
+#define SUCCESS_GENERATE 0
+#define SUCCESS_RUN_ENGINE 0
+#define SUCCESS_WRITE 0
+
+#define TRUE 1
+#define FALSE 0
+#define READ_EOF 0
+#define CHILD_PID 0
+#define STRING_EQUAL 0
+#define END_OF_OPTIONS -1
+#define OPTION_STRING "s:n:d:m:l:r:f:kSx:"
+#define ENGINE_DELIMITER '='
+#define ARG_DELIMITERS " "
+#define MAX_ENGINE_ARGS 32
+#define PROMPT_SUFFIX "number: "
+#define STOP_COMMAND "0\n"
+#define INDEX_SUFFIX ".idx"
+#define FILE_MODE 0644
+#define GENERATE_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_INIT_SIZE 4096
+#define COMMAND_SIZE 32
+#define NAME_SIZE 4096
+#define DEFAULT_FILE_SIZE (64LL * 1024 * 1024)
+#define DEFAULT_MEAN_LENGTH 80
+#define DEFAULT_LOOKUPS 1000
+#define DEFAULT_RANGE_LINES 10000
+#define DEFAULT_FILE_NAME "line_bench.txt"
+#define DEFAULT_SEED 0x9e3779b97f4a7c15ULL
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_USEC 1000.0
+#define NSEC_PER_MSEC 1000000.0
+#define BYTES_PER_GB 1e9
+#define BYTES_PER_MB 1e6
+#define P50 0.50
+#define P99 0.99
+#define FIRST_PRINTABLE 'a'
+#define PRINTABLE_COUNT 26
+#define SYSCALL_STOP (SIGTRAP | 0x80)
+#define STOPS_PER_SYSCALL 2
+
+typedef enum length_distribution {
+    FIXED_LENGTH,
+    UNIFORM_LENGTH,
+    EXPONENTIAL_LENGTH
+} length_distribution;
+
+typedef struct bench_options {
+    long long file_size;
+    long long line_count;
+    length_distribution distribution;
+    long long mean_length;
+    long long lookups;
+    long long range_lines;
+    const char *file_name;
+    int keep_file;
+    int count_syscalls;
+    const char *existing_file;
+    char **engines;
+    int engines_length;
+} bench_options;
+
+typedef struct bench_file {
+    const char *name;
+    off_t size;
+    off_t *offsets;
+    long long length;
+    char *addr;
+} bench_file;
+
+typedef struct engine_run {
+    pid_t pid;
+    int input_fildes;
+    int output_fildes;
+    int count_fildes;
+    char *output;
+    size_t output_size;
+    size_t output_length;
+} engine_run;
+
+typedef struct engine_result {
+    double cold_start_ms;
+    double warm_start_ms;
+    double lookup_p50_us;
+    double lookup_p99_us;
+    double sequential_mbps;
+    long peak_rss_kb;
+    long long syscalls;
+    long long mismatches;
+} engine_result;
+
+static uint64_t random_state = DEFAULT_SEED;
+
+uint64_t next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+double next_unit() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+long long now_nsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+long long next_line_length(bench_options *options) {
+    switch (options->distribution) {
+        case UNIFORM_LENGTH:
+            return next_random() % (2 * options->mean_length + 1);
+        case EXPONENTIAL_LENGTH:
+            return (long long) (-options->mean_length * log1p(-next_unit()));
+        default:
+            return options->mean_length;
+    }
+}
+
+int write_all(int fildes, const char *buf, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fildes, buf, length);
+        if (written == ERROR_WRITE) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERROR_WRITE;
+        }
+        buf += written;
+        length -= written;
+    }
+    return SUCCESS_WRITE;
+}
+
+int generate_file(bench_options *options) {
+    int fildes = open(options->file_name, O_WRONLY | O_CREAT | O_TRUNC, FILE_MODE);
+    if (fildes == ERROR_OPEN_FILE) {
+        perror("Can't create benchmark file");
+        return ERROR_GENERATE;
+    }
+
+    char *buf = (char *) malloc(GENERATE_BUFFER_SIZE);
+    if (buf == NULL) {
+        perror("Can't generate benchmark file");
+        close(fildes);
+        return ERROR_GENERATE;
+    }
+
+    long long size = 0, lines = 0;
+    size_t buf_length = 0;
+    int result = SUCCESS_GENERATE;
+    while (options->line_count > 0 ? lines < options->line_count : size < options->file_size) {
+        long long length = next_line_length(options);
+        for (long long i = 0; i <= length && result == SUCCESS_GENERATE; i++) {
+            if (buf_length == GENERATE_BUFFER_SIZE) {
+                if (write_all(fildes, buf, buf_length) == ERROR_WRITE) {
+                    perror("Can't write benchmark file");
+                    result = ERROR_GENERATE;
+                }
+                buf_length = 0;
+            }
+            buf[buf_length++] = (i == length) ? '\n' : FIRST_PRINTABLE + (size + i) % PRINTABLE_COUNT;
+        }
+        if (result == ERROR_GENERATE) {
+            break;
+        }
+        size += length + 1;
+        lines++;
+    }
+    if (result == SUCCESS_GENERATE && write_all(fildes, buf, buf_length) == ERROR_WRITE) {
+        perror("Can't write benchmark file");
+        result = ERROR_GENERATE;
+    }
+
+    free(buf);
+    close(fildes);
+    return result;
+}
+
+int load_bench_file(const char *name, bench_file *file) {
+    file->name = name;
+    file->offsets = NULL;
+    file->addr = NULL;
+
+    int fildes = open(name, O_RDONLY);
+    if (fildes == ERROR_OPEN_FILE) {
+        perror("Can't open benchmark file");
+        return ERROR_GENERATE;
+    }
+    struct stat file_stat;
+    fstat(fildes, &file_stat);
+    file->size = file_stat.st_size;
+    if (file->size > 0) {
+        file->addr = (char *) mmap(NULL, file->size, PROT_READ, MAP_SHARED, fildes, 0);
+    }
+    close(fildes);
+    if (file->addr == MAP_FAILED) {
+        perror("Can't map benchmark file");
+        file->addr = NULL;
+        return ERROR_GENERATE;
+    }
+
+    long long size = OUTPUT_INIT_SIZE;
+    file->offsets = (off_t *) malloc(size * sizeof(off_t));
+    if (file->offsets == NULL) {
+        perror("Can't index benchmark file");
+        return ERROR_GENERATE;
+    }
+    file->offsets[0] = 0;
+    file->length = 1;
+    const char *c = file->addr, *end = file->addr + file->size;
+    const char *new_line;
+    while (c < end && (new_line = (const char *) memchr(c, '\n', end - c)) != NULL) {
+        if (file->length == size) {
+            off_t *ptr = (off_t *) realloc(file->offsets, 2 * size * sizeof(off_t));
+            if (ptr == NULL) {
+                perror("Can't index benchmark file");
+                return ERROR_GENERATE;
+            }
+            file->offsets = ptr;
+            size *= 2;
+        }
+        file->offsets[file->length++] = new_line + 1 - file->addr;
+        c = new_line + 1;
+    }
+    return SUCCESS_GENERATE;
+}
+
+void line_bounds(bench_file *file, long long line_num, const char **line, size_t *length) {
+    off_t begin = file->offsets[line_num - 1];
+    off_t end = (line_num < file->length) ? file->offsets[line_num] - 1 : file->size;
+    *line = file->addr + begin;
+    *length = end - begin;
+}
+
+void remove_index(const char *file_name) {
+    char name[NAME_SIZE];
+    snprintf(name, NAME_SIZE, "%s%s", file_name, INDEX_SUFFIX);
+    unlink(name);
+}
+
+int split_engine(char *spec, char **name, char **args) {
+    char *delimiter = strchr(spec, ENGINE_DELIMITER);
+    if (delimiter == NULL) {
+        return ERROR_PARSE_OPTIONS;
+    }
+    *delimiter = '\0';
+    *name = spec;
+
+    char *command = strdup(delimiter + 1);
+    int count = 0;
+    for (char *arg = strtok(command, ARG_DELIMITERS); arg != NULL && count < MAX_ENGINE_ARGS - 2; arg = strtok(NULL, ARG_DELIMITERS)) {
+        args[count++] = arg;
+    }
+    args[count] = NULL;
+    return (count == 0) ? ERROR_PARSE_OPTIONS : count;
+}
+
+void exec_engine(char **args, int arg_count, const char *file_name, int input_fildes, int output_fildes) {
+    dup2(input_fildes, STDIN_FILENO);
+    dup2(output_fildes, STDOUT_FILENO);
+    close(input_fildes);
+    close(output_fildes);
+    args[arg_count] = (char *) file_name;
+    args[arg_count + 1] = NULL;
+    execvp(args[0], args);
+    perror("Can't start engine");
+    _exit(EXIT_FAILURE);
+}
+
+long long trace_syscalls(pid_t pid) {
+    int status;
+    waitpid(pid, &status, __WALL);
+    ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+    ptrace(PTRACE_SYSCALL, pid, 0, 0);
+
+    long long stops = 0;
+    while (TRUE) {
+        pid_t stopped = waitpid(-1, &status, __WALL);
+        if (stopped == ERROR_WAIT) {
+            break;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            continue;
+        }
+
+        int signal_number = 0;
+        if (WIFSTOPPED(status)) {
+            int stop_signal = WSTOPSIG(status);
+            if (stop_signal == SYSCALL_STOP) {
+                stops++;
+            } else if (stop_signal != SIGTRAP && stop_signal != SIGSTOP) {
+                signal_number = stop_signal;
+            }
+        }
+        ptrace(PTRACE_SYSCALL, stopped, 0, signal_number);
+    }
+    return stops / STOPS_PER_SYSCALL;
+}
+
+int start_engine(char **args, int arg_count, const char *file_name, int count_syscalls, engine_run *run) {
+    int input_pipe[2], output_pipe[2], count_pipe[2];
+    if (pipe(input_pipe) == ERROR_PIPE || pipe(output_pipe) == ERROR_PIPE || pipe(count_pipe) == ERROR_PIPE) {
+        perror("Can't create pipes");
+        return ERROR_RUN_ENGINE;
+    }
+
+    run->pid = fork();
+    if (run->pid == ERROR_FORK) {
+        perror("Can't start engine");
+        return ERROR_RUN_ENGINE;
+    }
+    if (run->pid == CHILD_PID) {
+        close(input_pipe[1]);
+        close(output_pipe[0]);
+        close(count_pipe[0]);
+        if (count_syscalls == FALSE) {
+            close(count_pipe[1]);
+            exec_engine(args, arg_count, file_name, input_pipe[0], output_pipe[1]);
+        }
+
+        pid_t engine = fork();
+        if (engine == CHILD_PID) {
+            close(count_pipe[1]);
+            ptrace(PTRACE_TRACEME, 0, 0, 0);
+            raise(SIGSTOP);
+            exec_engine(args, arg_count, file_name, input_pipe[0], output_pipe[1]);
+        }
+        close(input_pipe[0]);
+        close(output_pipe[1]);
+        long long syscalls = (engine == ERROR_FORK) ? 0 : trace_syscalls(engine);
+        write_all(count_pipe[1], (const char *) &syscalls, sizeof(syscalls));
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(input_pipe[0]);
+    close(output_pipe[1]);
+    close(count_pipe[1]);
+    run->input_fildes = input_pipe[1];
+    run->output_fildes = output_pipe[0];
+    run->count_fildes = count_pipe[0];
+    run->output_length = 0;
+    return SUCCESS_RUN_ENGINE;
+}
+
+int ends_with_prompt(engine_run *run) {
+    size_t suffix_length = strlen(PROMPT_SUFFIX);
+    return run->output_length >= suffix_length
+        && memcmp(run->output + run->output_length - suffix_length, PROMPT_SUFFIX, suffix_length) == STRING_EQUAL;
+}
+
+int read_until_prompt(engine_run *run) {
+    run->output_length = 0;
+    while (!ends_with_prompt(run)) {
+        if (run->output_length == run->output_size) {
+            char *ptr = (char *) realloc(run->output, 2 * run->output_size);
+            if (ptr == NULL) {
+                perror("Can't read engine output");
+                return ERROR_RUN_ENGINE;
+            }
+            run->output = ptr;
+            run->output_size *= 2;
+        }
+
+        ssize_t bytes_read = read(run->output_fildes, run->output + run->output_length, run->output_size - run->output_length);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read engine output");
+            return ERROR_RUN_ENGINE;
+        }
+        if (bytes_read == READ_EOF) {
+            fprintf(stderr, "Engine exited before prompting\n");
+            return ERROR_RUN_ENGINE;
+        }
+        run->output_length += bytes_read;
+    }
+    return SUCCESS_RUN_ENGINE;
+}
+
+int request_line(engine_run *run, bench_file *file, long long line_num, long long *mismatches) {
+    char command[COMMAND_SIZE];
+    int length = snprintf(command, COMMAND_SIZE, "%lld\n", line_num);
+    if (write_all(run->input_fildes, command, length) == ERROR_WRITE) {
+        perror("Can't send line number");
+        return ERROR_RUN_ENGINE;
+    }
+    if (read_until_prompt(run) == ERROR_RUN_ENGINE) {
+        return ERROR_RUN_ENGINE;
+    }
+
+    const char *line;
+    size_t line_length;
+    line_bounds(file, line_num, &line, &line_length);
+    size_t reply_length = run->output_length - strlen(PROMPT_SUFFIX);
+    const char *prompt = (const char *) memrchr(run->output, '\n', reply_length);
+    size_t body_length = (prompt == NULL) ? 0 : (size_t) (prompt - run->output);
+    if (body_length != line_length || memcmp(run->output, line, line_length) != STRING_EQUAL) {
+        (*mismatches)++;
+    }
+    return SUCCESS_RUN_ENGINE;
+}
+
+int compare_durations(const void *a, const void *b) {
+    long long first = *(const long long *) a, second = *(const long long *) b;
+    return (first > second) - (first < second);
+}
+
+double percentile_usec(long long *durations, long long count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    long long position = (long long) (percentile * (count - 1));
+    return durations[position] / NSEC_PER_USEC;
+}
+
+int finish_engine(engine_run *run, int count_syscalls, engine_result *result) {
+    write_all(run->input_fildes, STOP_COMMAND, strlen(STOP_COMMAND));
+    close(run->input_fildes);
+    while (read(run->output_fildes, run->output, run->output_size) > READ_EOF) {
+    }
+    close(run->output_fildes);
+
+    long long syscalls = 0;
+    if (read(run->count_fildes, &syscalls, sizeof(syscalls)) == sizeof(syscalls)) {
+        result->syscalls = syscalls;
+    }
+    close(run->count_fildes);
+
+    int status;
+    struct rusage usage;
+    pid_t wait_check = wait4(run->pid, &status, 0, &usage);
+    if (wait_check == ERROR_WAIT) {
+        perror("Can't wait for engine");
+        return ERROR_RUN_ENGINE;
+    }
+    if (count_syscalls == FALSE && usage.ru_maxrss > result->peak_rss_kb) {
+        result->peak_rss_kb = usage.ru_maxrss;
+    }
+    return SUCCESS_RUN_ENGINE;
+}
+
+int run_workload(char **args, int arg_count, bench_options *options, bench_file *file, int count_syscalls, int cold, engine_result *result) {
+    engine_run run;
+    run.output_size = OUTPUT_INIT_SIZE;
+    run.output = (char *) malloc(run.output_size);
+    if (run.output == NULL) {
+        perror("Can't run engine");
+        return ERROR_RUN_ENGINE;
+    }
+    if (cold == TRUE) {
+        remove_index(file->name);
+    }
+
+    long long start = now_nsec();
+    int check = start_engine(args, arg_count, file->name, count_syscalls, &run);
+    if (check == SUCCESS_RUN_ENGINE) {
+        check = read_until_prompt(&run);
+    }
+    double start_ms = (now_nsec() - start) / NSEC_PER_MSEC;
+    if (count_syscalls == FALSE) {
+        if (cold == TRUE) {
+            result->cold_start_ms = start_ms;
+        } else {
+            result->warm_start_ms = start_ms;
+        }
+    }
+
+    long long *durations = (long long *) malloc((options->lookups + 1) * sizeof(long long));
+    if (durations == NULL) {
+        perror("Can't run engine");
+        check = ERROR_RUN_ENGINE;
+    }
+    for (long long i = 0; i < options->lookups && check == SUCCESS_RUN_ENGINE; i++) {
+        long long line_num = 1 + next_random() % file->length;
+        long long begin = now_nsec();
+        check = request_line(&run, file, line_num, &result->mismatches);
+        durations[i] = now_nsec() - begin;
+    }
+    if (check == SUCCESS_RUN_ENGINE && count_syscalls == FALSE && cold == FALSE) {
+        qsort(durations, options->lookups, sizeof(long long), compare_durations);
+        result->lookup_p50_us = percentile_usec(durations, options->lookups, P50);
+        result->lookup_p99_us = percentile_usec(durations, options->lookups, P99);
+    }
+    free(durations);
+
+    long long range_lines = (options->range_lines < file->length) ? options->range_lines : file->length;
+    long long first = 1 + next_random() % (file->length - range_lines + 1);
+    long long begin = now_nsec();
+    for (long long line_num = first; line_num < first + range_lines && check == SUCCESS_RUN_ENGINE; line_num++) {
+        check = request_line(&run, file, line_num, &result->mismatches);
+    }
+    if (check == SUCCESS_RUN_ENGINE && count_syscalls == FALSE && cold == FALSE) {
+        long long elapsed = now_nsec() - begin;
+        off_t end = (first + range_lines <= file->length) ? file->offsets[first + range_lines - 1] : file->size;
+        result->sequential_mbps = (end - file->offsets[first - 1]) / BYTES_PER_MB / ((double) elapsed / NSEC_PER_SEC);
+    }
+
+    if (run.pid > 0) {
+        if (check == ERROR_RUN_ENGINE) {
+            kill(run.pid, SIGKILL);
+        }
+        finish_engine(&run, count_syscalls, result);
+    }
+    free(run.output);
+    return check;
+}
+
+void print_result(const char *name, bench_options *options, bench_file *file, engine_result *result) {
+    double build_gbps = (result->cold_start_ms > 0) ? file->size / BYTES_PER_GB / (result->cold_start_ms / 1000.0) : 0;
+    printf("{\"engine\":\"%s\",\"file_bytes\":%lld,\"lines\":%lld,\"distribution\":%d,\"mean_length\":%lld,"
+           "\"cold_start_ms\":%.3f,\"build_gbps\":%.3f,\"warm_start_ms\":%.3f,"
+           "\"lookups\":%lld,\"lookup_p50_us\":%.1f,\"lookup_p99_us\":%.1f,"
+           "\"sequential_lines\":%lld,\"sequential_mbps\":%.2f,\"peak_rss_kb\":%ld,\"syscalls\":%lld,\"mismatches\":%lld}\n",
+           name, (long long) file->size, file->length, options->distribution, options->mean_length,
+           result->cold_start_ms, build_gbps, result->warm_start_ms,
+           options->lookups, result->lookup_p50_us, result->lookup_p99_us,
+           options->range_lines, result->sequential_mbps, result->peak_rss_kb, result->syscalls, result->mismatches);
+    fflush(stdout);
+}
+
+void bench_engine(char *spec, bench_options *options, bench_file *file) {
+    char *name;
+    char *args[MAX_ENGINE_ARGS];
+    int arg_count = split_engine(spec, &name, args);
+    if (arg_count == ERROR_PARSE_OPTIONS) {
+        fprintf(stderr, "Invalid engine %s, expected name=command\n", spec);
+        return;
+    }
+
+    engine_result result;
+    memset(&result, 0, sizeof(result));
+    result.syscalls = -1;
+
+    uint64_t seed = random_state;
+    int check = run_workload(args, arg_count, options, file, FALSE, TRUE, &result);
+    random_state = seed;
+    if (check == SUCCESS_RUN_ENGINE) {
+        check = run_workload(args, arg_count, options, file, FALSE, FALSE, &result);
+    }
+    if (check == SUCCESS_RUN_ENGINE && options->count_syscalls == TRUE) {
+        random_state = seed;
+        long long mismatches = result.mismatches;
+        check = run_workload(args, arg_count, options, file, TRUE, FALSE, &result);
+        result.mismatches = mismatches;
+    }
+    free(args[0]);
+
+    if (check == ERROR_RUN_ENGINE) {
+        fprintf(stderr, "Engine %s failed\n", name);
+        return;
+    }
+    print_result(name, options, file, &result);
+}
+
+void print_usage(const char *program) {
+    printf("Usage: %s [-s bytes] [-n lines] [-d fixed|uniform|exp] [-m mean length] [-l lookups] [-r sequential lines]\n"
+           "       [-f file] [-k] [-S] [-x existing file] name=command...\n", program);
+}
+
+int parse_options(int argc, char **argv, bench_options *options) {
+    options->file_size = DEFAULT_FILE_SIZE;
+    options->line_count = 0;
+    options->distribution = FIXED_LENGTH;
+    options->mean_length = DEFAULT_MEAN_LENGTH;
+    options->lookups = DEFAULT_LOOKUPS;
+    options->range_lines = DEFAULT_RANGE_LINES;
+    options->file_name = DEFAULT_FILE_NAME;
+    options->keep_file = FALSE;
+    options->count_syscalls = FALSE;
+    options->existing_file = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, OPTION_STRING)) != END_OF_OPTIONS) {
+        switch (option) {
+            case 's':
+                options->file_size = atoll(optarg);
+                break;
+            case 'n':
+                options->line_count = atoll(optarg);
+                break;
+            case 'd':
+                if (strcmp(optarg, "uniform") == STRING_EQUAL) {
+                    options->distribution = UNIFORM_LENGTH;
+                } else if (strcmp(optarg, "exp") == STRING_EQUAL) {
+                    options->distribution = EXPONENTIAL_LENGTH;
+                } else if (strcmp(optarg, "fixed") == STRING_EQUAL) {
+                    options->distribution = FIXED_LENGTH;
+                } else {
+                    return ERROR_PARSE_OPTIONS;
+                }
+                break;
+            case 'm':
+                options->mean_length = atoll(optarg);
+                break;
+            case 'l':
+                options->lookups = atoll(optarg);
+                break;
+            case 'r':
+                options->range_lines = atoll(optarg);
+                break;
+            case 'f':
+                options->file_name = optarg;
+                break;
+            case 'k':
+                options->keep_file = TRUE;
+                break;
+            case 'S':
+                options->count_syscalls = TRUE;
+                break;
+            case 'x':
+                options->existing_file = optarg;
+                break;
+            default:
+                return ERROR_PARSE_OPTIONS;
+        }
+    }
+
+    if (optind >= argc || options->mean_length < 0 || options->lookups < 0 || options->range_lines < 0) {
+        return ERROR_PARSE_OPTIONS;
+    }
+    options->engines = argv + optind;
+    options->engines_length = argc - optind;
+    return SUCCESS_PARSE_OPTIONS;
+}
+
+int main(int argc, char **argv) {
+    bench_options options;
+    int parse_check = parse_options(argc, argv, &options);
+    if (parse_check == ERROR_PARSE_OPTIONS) {
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    const char *file_name = options.existing_file;
+    if (file_name == NULL) {
+        if (generate_file(&options) == ERROR_GENERATE) {
+            return 0;
+        }
+        file_name = options.file_name;
+    }
+
+    bench_file file;
+    if (load_bench_file(file_name, &file) == SUCCESS_GENERATE) {
+        for (int i = 0; i < options.engines_length; i++) {
+            bench_engine(options.engines[i], &options, &file);
+        }
+    }
+
+    remove_index(file_name);
+    if (file.addr != NULL) {
+        munmap(file.addr, file.size);
+    }
+    free(file.offsets);
+    if (options.existing_file == NULL && options.keep_file == FALSE) {
+        unlink(options.file_name);
+    }
+    return 0;
+}
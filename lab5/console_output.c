@@ -0,0 +1,102 @@
+#include "console_output.h"
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_WRITEV -1
+
+int write_vector(int fildes, struct iovec *iov, int iov_count) {
+    while (iov_count > 0) {
+        ssize_t written = writev(fildes, iov, iov_count);
+        if (written == ERROR_WRITEV) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return OUTPUT_ERROR;
+        }
+
+        while (iov_count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return OUTPUT_SUCCESS;
+}
+
+int write_all(int fildes, const char *buf, size_t length) {
+    struct iovec iov;
+    iov.iov_base = (void *) buf;
+    iov.iov_len = length;
+    return write_vector(fildes, &iov, 1);
+}
+
+void output_init(output_buffer *out, int fildes) {
+    out->fildes = fildes;
+    out->iov_count = 0;
+    out->data_length = 0;
+}
+
+static int add_vector(output_buffer *out, const char *buf, size_t length) {
+    if (length == 0) {
+        return OUTPUT_SUCCESS;
+    }
+
+    if (out->iov_count > 0) {
+        struct iovec *last = &out->iov[out->iov_count - 1];
+        if ((const char *) last->iov_base + last->iov_len == buf) {
+            last->iov_len += length;
+            return OUTPUT_SUCCESS;
+        }
+    }
+
+    if (out->iov_count == OUTPUT_IOV_MAX) {
+        int flush_check = output_flush(out);
+        if (flush_check == OUTPUT_ERROR) {
+            return OUTPUT_ERROR;
+        }
+    }
+    out->iov[out->iov_count].iov_base = (void *) buf;
+    out->iov[out->iov_count].iov_len = length;
+    out->iov_count++;
+    return OUTPUT_SUCCESS;
+}
+
+int output_append(output_buffer *out, const char *buf, size_t length) {
+    if (length > OUTPUT_BUFFER_SIZE / 2 || out->iov_count == OUTPUT_IOV_MAX) {
+        int flush_check = output_flush(out);
+        if (flush_check == OUTPUT_ERROR) {
+            return OUTPUT_ERROR;
+        }
+    }
+    if (length > OUTPUT_BUFFER_SIZE / 2) {
+        return write_all(out->fildes, buf, length);
+    }
+
+    if (out->data_length + length > OUTPUT_BUFFER_SIZE) {
+        int flush_check = output_flush(out);
+        if (flush_check == OUTPUT_ERROR) {
+            return OUTPUT_ERROR;
+        }
+    }
+
+    char *data = out->data + out->data_length;
+    memcpy(data, buf, length);
+    out->data_length += length;
+    return add_vector(out, data, length);
+}
+
+int output_reference(output_buffer *out, const char *buf, size_t length) {
+    return add_vector(out, buf, length);
+}
+
+int output_flush(output_buffer *out) {
+    int write_check = write_vector(out->fildes, out->iov, out->iov_count);
+    out->iov_count = 0;
+    out->data_length = 0;
+    return write_check;
+}
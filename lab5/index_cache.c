@@ -0,0 +1,231 @@
+#include "index_cache.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_OPEN -1
+#define ERROR_FSTAT -1
+#define ERROR_WRITE -1
+#define ERROR_CLOSE -1
+#define ERROR_RENAME -1
+#define ERROR_MUNMAP -1
+#define ERROR_FCHMOD -1
+
+#define TMP_SUFFIX_SIZE 32
+#define ENTRY_SIZE_DIGITS 20
+#define TMP_TEMPLATE ".XXXXXX"
+#define CACHE_FILE_MODE 0644
+#define STRING_EQUAL 0
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static char *cache_name(const char *file_name, size_t entry_size) {
+    size_t size = strlen(file_name) + strlen(INDEX_CACHE_SUFFIX) + ENTRY_SIZE_DIGITS + TMP_SUFFIX_SIZE;
+    char *name = (char *) malloc(size);
+    if (name == NULL) {
+        perror("Can't allocate index cache name");
+        return NULL;
+    }
+    snprintf(name, size, "%s%s%zu", file_name, INDEX_CACHE_SUFFIX, entry_size);
+    return name;
+}
+
+static uint64_t table_checksum(const line_info *table, uint64_t table_length) {
+    const uint64_t *word = (const uint64_t *) table;
+    uint64_t words = table_length * sizeof(line_info) / sizeof(uint64_t);
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (uint64_t i = 0; i < words; i++) {
+        hash ^= word[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static void fill_header(index_cache_header *header, const struct stat *file_stat, const line_info *table, uint64_t table_length) {
+    memset(header, 0, sizeof(index_cache_header));
+    memcpy(header->magic, INDEX_CACHE_MAGIC, sizeof(INDEX_CACHE_MAGIC));
+    header->version = INDEX_CACHE_VERSION;
+    header->entry_size = sizeof(line_info);
+    header->file_device = file_stat->st_dev;
+    header->file_inode = file_stat->st_ino;
+    header->file_size = file_stat->st_size;
+    header->file_mtime_sec = file_stat->st_mtim.tv_sec;
+    header->file_mtime_nsec = file_stat->st_mtim.tv_nsec;
+    header->table_length = table_length;
+    header->checksum = table_checksum(table, table_length);
+}
+
+static int header_matches(const index_cache_header *header, const struct stat *file_stat, size_t cache_size) {
+    if (memcmp(header->magic, INDEX_CACHE_MAGIC, sizeof(INDEX_CACHE_MAGIC)) != STRING_EQUAL
+            || header->version != INDEX_CACHE_VERSION) {
+        return 0;
+    }
+    if (header->entry_size != sizeof(line_info)) {
+        fprintf(stderr, "Index cache holds %u-byte entries instead of %zu-byte ones, rebuilding it\n",
+                header->entry_size, sizeof(line_info));
+        return 0;
+    }
+    if (header->file_device != (uint64_t) file_stat->st_dev
+            || header->file_inode != (uint64_t) file_stat->st_ino
+            || header->file_size != (uint64_t) file_stat->st_size
+            || header->file_mtime_sec != (int64_t) file_stat->st_mtim.tv_sec
+            || header->file_mtime_nsec != (int64_t) file_stat->st_mtim.tv_nsec) {
+        return 0;
+    }
+    if (header->table_length > (cache_size - sizeof(index_cache_header)) / sizeof(line_info)
+            || cache_size != sizeof(index_cache_header) + header->table_length * sizeof(line_info)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int write_all(int fildes, const void *buf, size_t length) {
+    const char *ptr = (const char *) buf;
+    while (length > 0) {
+        ssize_t write_check = write(fildes, ptr, length);
+        if (write_check == ERROR_WRITE) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't write index cache");
+            return INDEX_CACHE_ERROR;
+        }
+        ptr += write_check;
+        length -= write_check;
+    }
+    return INDEX_CACHE_SUCCESS;
+}
+
+line_info *load_index_cache(const char *file_name, const struct stat *file_stat, long long *table_length, index_cache *cache) {
+    if (file_name == NULL || file_stat == NULL || table_length == NULL || cache == NULL) {
+        fprintf(stderr, "Can't load index cache: Invalid argument(s)\n");
+        return NULL;
+    }
+    cache->addr = NULL;
+    cache->size = 0;
+
+    char *name = cache_name(file_name, sizeof(line_info));
+    if (name == NULL) {
+        return NULL;
+    }
+    int fildes = open(name, O_RDONLY);
+    free(name);
+    if (fildes == ERROR_OPEN) {
+        if (errno != ENOENT) {
+            perror("Can't open index cache");
+        }
+        return NULL;
+    }
+
+    struct stat cache_stat;
+    int fstat_check = fstat(fildes, &cache_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get index cache stat");
+        close(fildes);
+        return NULL;
+    }
+    size_t cache_size = cache_stat.st_size;
+    if (cache_size < sizeof(index_cache_header)) {
+        close(fildes);
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, cache_size, PROT_READ, MAP_SHARED, fildes, 0);
+    close(fildes);
+    if (addr == MAP_FAILED) {
+        perror("Can't map index cache");
+        return NULL;
+    }
+
+    index_cache_header *header = (index_cache_header *) addr;
+    line_info *table = (line_info *) ((char *) addr + sizeof(index_cache_header));
+    if (!header_matches(header, file_stat, cache_size) || table_checksum(table, header->table_length) != header->checksum) {
+        munmap(addr, cache_size);
+        return NULL;
+    }
+
+    cache->addr = addr;
+    cache->size = cache_size;
+    *table_length = header->table_length;
+    return table;
+}
+
+int save_index_cache(const char *file_name, const struct stat *file_stat, line_info *table, long long table_length) {
+    if (file_name == NULL || file_stat == NULL || table == NULL || table_length < 0) {
+        fprintf(stderr, "Can't save index cache: Invalid argument(s)\n");
+        return INDEX_CACHE_ERROR;
+    }
+
+    char *name = cache_name(file_name, sizeof(line_info));
+    char *tmp_name = cache_name(file_name, sizeof(line_info));
+    if (name == NULL || tmp_name == NULL) {
+        free(name);
+        free(tmp_name);
+        return INDEX_CACHE_ERROR;
+    }
+    size_t name_length = strlen(name);
+    snprintf(tmp_name + name_length, TMP_SUFFIX_SIZE, TMP_TEMPLATE);
+
+    /* a fresh file of our own, not whatever a planted name points to */
+    int fildes = mkstemp(tmp_name);
+    if (fildes == ERROR_OPEN || fchmod(fildes, CACHE_FILE_MODE) == ERROR_FCHMOD) {
+        perror("Can't create index cache");
+        if (fildes != ERROR_OPEN) {
+            close(fildes);
+            unlink(tmp_name);
+        }
+        free(name);
+        free(tmp_name);
+        return INDEX_CACHE_ERROR;
+    }
+
+    index_cache_header header;
+    fill_header(&header, file_stat, table, table_length);
+
+    int result = write_all(fildes, &header, sizeof(index_cache_header));
+    if (result == INDEX_CACHE_SUCCESS) {
+        result = write_all(fildes, table, table_length * sizeof(line_info));
+    }
+
+    int close_check = close(fildes);
+    if (close_check == ERROR_CLOSE) {
+        perror("Can't close index cache");
+        result = INDEX_CACHE_ERROR;
+    }
+
+    if (result == INDEX_CACHE_SUCCESS) {
+        int rename_check = rename(tmp_name, name);
+        if (rename_check == ERROR_RENAME) {
+            perror("Can't replace index cache");
+            result = INDEX_CACHE_ERROR;
+        }
+    }
+    if (result == INDEX_CACHE_ERROR) {
+        unlink(tmp_name);
+    }
+
+    free(name);
+    free(tmp_name);
+    return result;
+}
+
+int close_index_cache(index_cache *cache) {
+    if (cache == NULL || cache->addr == NULL) {
+        return INDEX_CACHE_SUCCESS;
+    }
+
+    int munmap_check = munmap(cache->addr, cache->size);
+    if (munmap_check == ERROR_MUNMAP) {
+        perror("Can't unmap index cache");
+        return INDEX_CACHE_ERROR;
+    }
+    cache->addr = NULL;
+    cache->size = 0;
+    return INDEX_CACHE_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#ifndef LAB5_INDEX_CACHE_H
+#define LAB5_INDEX_CACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include "line_info.h"
+
+#define INDEX_CACHE_ERROR -1
+#define INDEX_CACHE_SUCCESS 0
+
+#define INDEX_CACHE_MAGIC "LINEIDX"
+#define INDEX_CACHE_MAGIC_SIZE 8
+#define INDEX_CACHE_VERSION 1
+#define INDEX_CACHE_SUFFIX ".idx"
+
+/*
+ * The table is kept in "<file>.idx16", named after its entry size: lab6
+ * and lab7's lazy modes read and write the same file, while lab7's
+ * offset tables go to their own ".idx4"/".idx8" sidecars. Staleness is
+ * judged from the device, inode, size and mtime only; the checksum
+ * guards the stored table, not the file contents.
+ */
+typedef struct index_cache_header {
+    char magic[INDEX_CACHE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t file_device;
+    uint64_t file_inode;
+    uint64_t file_size;
+    int64_t file_mtime_sec;
+    int64_t file_mtime_nsec;
+    uint64_t table_length;
+    uint64_t checksum;
+} index_cache_header;
+
+typedef struct index_cache {
+    void *addr;
+    size_t size;
+} index_cache;
+
+line_info *load_index_cache(const char *file_name, const struct stat *file_stat, long long *table_length, index_cache *cache);
+int save_index_cache(const char *file_name, const struct stat *file_stat, line_info *table, long long table_length);
+int close_index_cache(index_cache *cache);
+
+#endif
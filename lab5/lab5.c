@@ -1,10 +1,15 @@
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include "line_info.h"
+#include "index_cache.h"
+#include "line_table.h"
+#include "console_output.h"
 
 extern int errno;
 
@@ -14,7 +19,10 @@ extern int errno;
 #define ERROR_WRITE -1
 #define ERROR_ADD_TO_TABLE -1
 #define ERROR_GET_LINE_NUMBER -1
-#define ERROR_LSEEK -1
+#define ERROR_PRINT_LINE -1
+#define ERROR_FSTAT -1
+#define ERROR_FILL_TABLE -1
+#define ERROR_SPILL -1
 #define ERROR_ADD_TO_TABLE -1
 
 #define SUCCESS_CLOSE_FILE 0
@@ -22,24 +30,29 @@ extern int errno;
 #define SUCCESS_WRITE 0
 #define SUCCESS_GET_LINE_NUMBER 1
 #define SUCCESS_ADD_TO_TABLE 0
+#define SUCCESS_PRINT_LINE 0
+#define SUCCESS_FILL_TABLE 0
+#define SUCCESS_SPILL 0
 #define NO_ERROR 0
 
 #define STRING_EQUAL 0
 #define INVALID_LINE_NUMBER_INPUT 0
 #define READ_EOF 0
 #define TABLE_INIT_SIZE 100
-#define READ_INIT -1
 #define INPUT_SIZE 128
 #define TRUE 1
+#define FALSE 0
 #define STOP_INPUT 0
 #define DECIMAL_SYSTEM 10
 #define WITH_NEW_LINE 1
 #define WITHOUT_NEW_LINE 0
-
-typedef struct line_info {
-	off_t offset;
-	size_t length;
-} line_info;
+#define LINE_CHUNK_SIZE (64 * 1024)
+#define STREAM_BUFFER_SIZE (1024 * 1024)
+#define NO_SPILL -1
+#define SPILL_NAME_SIZE 4096
+#define SPILL_TEMPLATE "%s/lab5-XXXXXX"
+#define DEFAULT_TMP_DIR "/tmp"
+#define FILE_START_POS 0
 
 int add_to_table(line_info **table, long long *table_size, long long *table_length, off_t line_offset, size_t line_length) {
 	if (table == NULL || *table == NULL || table_size == NULL || table_length == NULL) {
@@ -48,9 +61,8 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
 	}
 
 	if (*table_length == *table_size) {
-		line_info *ptr = (line_info *)realloc(*table, 2 * (*table_size) * sizeof(line_info));
+		line_info *ptr = line_table_grow(*table, 2 * (*table_size));
 		if (ptr == NULL) {
-			perror("Can't create table");
 			return ERROR_ADD_TO_TABLE;
 		}
 		*table = ptr;
@@ -67,71 +79,122 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
 	return SUCCESS_ADD_TO_TABLE;
 }
 
-line_info *create_table(int fildes, long long *table_length) {
+int fill_table(int fildes, int spill_fildes, line_info **table, long long *size, long long *table_length) {
+	off_t line_offset = 0, file_offset = 0;
+	char *buf = (char *) malloc(STREAM_BUFFER_SIZE);
+	if (buf == NULL) {
+		perror("Can't create table");
+		return ERROR_FILL_TABLE;
+	}
+
+	while (TRUE) {
+		ssize_t bytes_read = read(fildes, buf, STREAM_BUFFER_SIZE);
+		if (bytes_read == ERROR_READ) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Can't read from file");
+			free(buf);
+			return ERROR_FILL_TABLE;
+		}
+		if (bytes_read == READ_EOF) {
+			break;
+		}
+
+		if (spill_fildes != NO_SPILL) {
+			int write_check = write_all(spill_fildes, buf, bytes_read);
+			if (write_check == OUTPUT_ERROR) {
+				perror("Can't write to backing file");
+				free(buf);
+				return ERROR_FILL_TABLE;
+			}
+		}
+
+		char *c = buf, *end = buf + bytes_read;
+		char *new_line;
+		while ((new_line = (char *) memchr(c, '\n', end - c)) != NULL) {
+			off_t new_line_offset = file_offset + (new_line - buf);
+			int add_check = add_to_table(table, size, table_length, line_offset, new_line_offset - line_offset);
+			if (add_check == ERROR_ADD_TO_TABLE) {
+				free(buf);
+				return ERROR_FILL_TABLE;
+			}
+			line_offset = new_line_offset + 1;
+			c = new_line + 1;
+		}
+		file_offset += bytes_read;
+	}
+	free(buf);
+
+	int add_check = add_to_table(table, size, table_length, line_offset, file_offset - line_offset);
+	if (add_check == ERROR_ADD_TO_TABLE) {
+		return ERROR_FILL_TABLE;
+	}
+	return SUCCESS_FILL_TABLE;
+}
+
+line_info *create_table(int fildes, int spill_fildes, long long expected_length, long long *table_length) {
 	if (table_length == NULL) {
 		fprintf(stderr, "Can't create table: Invalid argument\n");
 		return NULL;
 	}
-	
-	long long size = TABLE_INIT_SIZE;
-	size_t line_length = 0, read_length = 1;
-	off_t line_offset = 0;
-	ssize_t read_check = READ_INIT;
-	char c;
-
 
+	long long size = expected_length;
 	*table_length = 0;
-	line_info *table = (line_info *) malloc(size * sizeof(line_info));
+	line_info *table = line_table_create(size);
 	if (table == NULL) {
-		perror("Can't create table");
 		return NULL;
 	}
 
-        line_offset = lseek(fildes, 0L, SEEK_SET);
-	if (line_offset == ERROR_LSEEK) {
-		perror("Can't get/set position in file");
-		free(table);
+	int fill_check = fill_table(fildes, spill_fildes, &table, &size, table_length);
+	if (fill_check == ERROR_FILL_TABLE) {
+		line_table_free(table);
 		return NULL;
 	}
 
-	while (read_check != READ_EOF) {
-		read_check = read(fildes, &c, read_length);
-		if (read_check == ERROR_READ) {
-			perror("Can't read from file");
-			free(table);
-			return NULL;
-		}
-		if (read_check != READ_EOF && c != '\n') {
-			line_length++;
-			continue;
-		}
+	return table;
+}
 
-		int add_check = add_to_table(&table, &size, table_length, line_offset, line_length);
-		if (add_check == ERROR_ADD_TO_TABLE) {
-			free(table);
-			return NULL;
-		}
+int is_streamed(int fildes, struct stat *file_stat) {
+	if (!S_ISREG(file_stat->st_mode)) {
+		return TRUE;
+	}
+	if (file_stat->st_size != 0) {
+		return FALSE;
+	}
+	char probe;
+	return pread(fildes, &probe, 1, FILE_START_POS) > 0;
+}
 
-		line_length = 0;
-		line_offset = lseek(fildes, 0L, SEEK_CUR);
-		if (line_offset == ERROR_LSEEK) {
-			perror("Can't get/set position in file");
-			free(table);
-			return NULL;
-		}
+int create_spill_file(int *spill_fildes) {
+	const char *tmp_dir = getenv("TMPDIR");
+	if (tmp_dir == NULL) {
+		tmp_dir = DEFAULT_TMP_DIR;
 	}
-	return table;
+
+	char name[SPILL_NAME_SIZE];
+	snprintf(name, SPILL_NAME_SIZE, SPILL_TEMPLATE, tmp_dir);
+	*spill_fildes = mkstemp(name);
+	if (*spill_fildes == ERROR_OPEN_FILE) {
+		perror("Can't create backing file");
+		return ERROR_SPILL;
+	}
+	unlink(name);
+	return SUCCESS_SPILL;
 }
 
 int write_to_console(const char *buf, size_t length, int new_line) {
-	ssize_t write_check = write(STDOUT_FILENO, buf, length);
-	if (write_check == ERROR_WRITE) {
+	struct iovec iov[2];
+	iov[0].iov_base = (void *) buf;
+	iov[0].iov_len = length;
+	iov[1].iov_base = "\n";
+	iov[1].iov_len = 1;
+
+	int write_check = write_vector(STDOUT_FILENO, iov, (new_line == WITH_NEW_LINE) ? 2 : 1);
+	if (write_check == OUTPUT_ERROR) {
 		perror("Can't write to console");
 		return ERROR_WRITE;
 	}
-	if (new_line == WITH_NEW_LINE) {
-		return write_to_console("\n", 1, WITHOUT_NEW_LINE);
-	}
 	return SUCCESS_WRITE;
 }
 
@@ -154,6 +217,7 @@ int get_line_number(long long *line_num) {
    	input[bytes_read] = '\0';
 
 	char *endptr = input;
+	errno = NO_ERROR;
 	*line_num = strtoll(input, &endptr, DECIMAL_SYSTEM);	
 
 	if (errno != NO_ERROR) {
@@ -173,19 +237,57 @@ int get_line_number(long long *line_num) {
 }
 
 int read_line(int fildes, off_t offset, size_t length, char *buf) {
-	off_t lseek_check = lseek(fildes, offset, SEEK_SET);
-	if (lseek_check == ERROR_LSEEK) {
-		perror("Can't get/set position in file");
-		return ERROR_READ;
+	while (length > 0) {
+		ssize_t read_check = pread(fildes, buf, length, offset);
+		if (read_check == ERROR_READ) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Can't read from file");
+			return ERROR_READ;
+		}
+		if (read_check == READ_EOF) {
+			fprintf(stderr, "Can't read from file: Unexpected end of file\n");
+			return ERROR_READ;
+		}
+		buf += read_check;
+		offset += read_check;
+		length -= read_check;
 	}
 
-	ssize_t read_check = read(fildes, buf, length);
-	if (read_check == ERROR_READ) {
-		perror("Can't read from file");
-		return ERROR_READ;
+	return SUCCESS_READ;
+}
+
+int print_line(int fildes, line_info *table, long long line_num) {
+	off_t line_offset = table[line_num - 1].offset;
+	size_t line_length = table[line_num - 1].length;
+	size_t chunk_size = (line_length < LINE_CHUNK_SIZE) ? line_length : LINE_CHUNK_SIZE;
+
+	char *chunk = (char *) malloc(chunk_size + 1);
+	if (chunk == NULL) {
+		perror("Can't print line");
+		return ERROR_PRINT_LINE;
 	}
 
-	return SUCCESS_READ;
+	do {
+		size_t part = (line_length < chunk_size) ? line_length : chunk_size;
+		int read_check = read_line(fildes, line_offset, part, chunk);
+		if (read_check == ERROR_READ) {
+			free(chunk);
+			return ERROR_PRINT_LINE;
+		}
+		line_offset += part;
+		line_length -= part;
+
+		int write_check = write_to_console(chunk, part, (line_length == 0) ? WITH_NEW_LINE : WITHOUT_NEW_LINE);
+		if (write_check == ERROR_WRITE) {
+			free(chunk);
+			return ERROR_PRINT_LINE;
+		}
+	} while (line_length > 0);
+
+	free(chunk);
+	return SUCCESS_PRINT_LINE;
 }
 
 int main(int argc, char** argv) {
@@ -200,8 +302,41 @@ int main(int argc, char** argv) {
 		return 0;
 	}	
 
+	struct stat file_stat;
+	int fstat_check = fstat(fildes, &file_stat);
+	if (fstat_check == ERROR_FSTAT) {
+		perror("Can't get file stat");
+		close(fildes);
+		return 0;
+	}
+
+	int spill_fildes = NO_SPILL;
+	if (is_streamed(fildes, &file_stat)) {
+		int spill_check = create_spill_file(&spill_fildes);
+		if (spill_check == ERROR_SPILL) {
+			close(fildes);
+			return 0;
+		}
+	}
+
+	index_cache cache;
+	cache.addr = NULL;
 	long long table_length = 0, line_num = 0;
-	line_info *table = create_table(fildes, &table_length);
+	line_info *table = NULL;
+	if (spill_fildes == NO_SPILL) {
+		table = load_index_cache(argv[1], &file_stat, &table_length, &cache);
+	}
+	if (table == NULL) {
+		long long expected_length = (spill_fildes == NO_SPILL) ? estimate_line_count(fildes, file_stat.st_size) : TABLE_INIT_SIZE;
+		table = create_table(fildes, spill_fildes, expected_length, &table_length);
+		if (table != NULL && spill_fildes == NO_SPILL) {
+			save_index_cache(argv[1], &file_stat, table, table_length);
+		}
+	}
+	if (spill_fildes != NO_SPILL) {
+		close(fildes);
+		fildes = spill_fildes;
+	}
 	if (table != NULL) {
 		while(TRUE) {	
 			int get_line_num_check = get_line_number(&line_num);
@@ -223,22 +358,17 @@ int main(int argc, char** argv) {
 				break;
 			}
 
-			off_t line_offset = table[line_num - 1].offset;
-			size_t line_length = table[line_num - 1].length;
-			char line[line_length];
-
-			int read_check = read_line(fildes, line_offset, line_length, line);
-			if (read_check == ERROR_READ) {
-				break;
-			}
-
-			int write_check = write_to_console(line, line_length, WITH_NEW_LINE);
-			if (write_check == ERROR_WRITE) {
+			int print_check = print_line(fildes, table, line_num);
+			if (print_check == ERROR_PRINT_LINE) {
 				break;
 			}
 		}
 
-		free(table);
+		if (cache.addr != NULL) {
+			close_index_cache(&cache);
+		} else {
+			line_table_free(table);
+		}
 	}
 
 	int close_check = close(fildes); 
@@ -0,0 +1,14 @@
+#ifndef LAB5_LINE_TABLE_H
+#define LAB5_LINE_TABLE_H
+
+#include <sys/types.h>
+#include "line_info.h"
+
+#define LINE_TABLE_MIN_SIZE 100
+
+line_info *line_table_create(long long table_size);
+line_info *line_table_grow(line_info *table, long long table_size);
+void line_table_free(line_info *table);
+long long estimate_line_count(int fildes, off_t file_size);
+
+#endif
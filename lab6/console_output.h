@@ -0,0 +1,30 @@
+#ifndef LAB6_CONSOLE_OUTPUT_H
+#define LAB6_CONSOLE_OUTPUT_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stddef.h>
+
+#define OUTPUT_ERROR -1
+#define OUTPUT_SUCCESS 0
+
+#define OUTPUT_IOV_MAX 256
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+typedef struct output_buffer {
+    int fildes;
+    struct iovec iov[OUTPUT_IOV_MAX];
+    int iov_count;
+    char data[OUTPUT_BUFFER_SIZE];
+    size_t data_length;
+} output_buffer;
+
+int write_vector(int fildes, struct iovec *iov, int iov_count);
+int write_all(int fildes, const char *buf, size_t length);
+
+void output_init(output_buffer *out, int fildes);
+int output_append(output_buffer *out, const char *buf, size_t length);
+int output_reference(output_buffer *out, const char *buf, size_t length);
+int output_flush(output_buffer *out);
+
+#endif
@@ -0,0 +1,201 @@
+#include "event_loop.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_EPOLL -1
+#define ERROR_TIMERFD -1
+#define ERROR_SIGNALFD -1
+#define ERROR_SIGMASK -1
+#define ERROR_CLOCK -1
+#define NO_FILDES -1
+#define NO_TIMEOUT -1
+#define POLL_ONLY 0
+#define TRUE 1
+#define FALSE 0
+
+static int watch(event_loop *loop, int fildes) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fildes;
+    return epoll_ctl(loop->epoll_fildes, EPOLL_CTL_ADD, fildes, &event);
+}
+
+static void read_signals(event_loop *loop) {
+    struct signalfd_siginfo info;
+    while (read(loop->signal_fildes, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGINT) {
+            loop->interrupted = TRUE;
+        }
+    }
+}
+
+static void read_timer(event_loop *loop) {
+    uint64_t expirations = 0;
+    ssize_t bytes_read = read(loop->timer_fildes, &expirations, sizeof(expirations));
+    if (bytes_read == sizeof(expirations) && expirations > 0) {
+        loop->deadline_passed = TRUE;
+    }
+}
+
+static void drop_ready(int *ready, int first, int *length, int fildes) {
+    int kept = first;
+    for (int i = first; i < *length; i++) {
+        if (ready[i] != fildes) {
+            ready[kept++] = ready[i];
+        }
+    }
+    *length = kept;
+}
+
+event_loop *event_loop_create() {
+    event_loop *loop = (event_loop *) calloc(1, sizeof(event_loop));
+    if (loop == NULL) {
+        perror("Can't create event loop");
+        return NULL;
+    }
+    loop->epoll_fildes = NO_FILDES;
+    loop->timer_fildes = NO_FILDES;
+    loop->signal_fildes = NO_FILDES;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    int mask_check = sigprocmask(SIG_BLOCK, &mask, &loop->old_mask);
+    if (mask_check == ERROR_SIGMASK) {
+        perror("Can't block signals");
+        free(loop);
+        return NULL;
+    }
+
+    loop->epoll_fildes = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fildes = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->signal_fildes = signalfd(NO_FILDES, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (loop->epoll_fildes == ERROR_EPOLL || loop->timer_fildes == ERROR_TIMERFD || loop->signal_fildes == ERROR_SIGNALFD
+            || watch(loop, loop->timer_fildes) == ERROR_EPOLL || watch(loop, loop->signal_fildes) == ERROR_EPOLL) {
+        perror("Can't create event loop");
+        event_loop_destroy(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+int event_loop_add(event_loop *loop, int fildes) {
+    int watch_check = watch(loop, fildes);
+    if (watch_check != ERROR_EPOLL) {
+        return EVENT_LOOP_SUCCESS;
+    }
+
+    /* epoll refuses regular files; they are always readable, as select reported them */
+    if (errno == EPERM && loop->always_ready_length < EVENT_LOOP_MAX_EVENTS) {
+        loop->always_ready[loop->always_ready_length++] = fildes;
+        return EVENT_LOOP_SUCCESS;
+    }
+    perror("Can't watch input");
+    return EVENT_LOOP_ERROR;
+}
+
+int event_loop_remove(event_loop *loop, int fildes) {
+    drop_ready(loop->ready, loop->ready_next, &loop->ready_length, fildes);
+    int always_length = loop->always_ready_length;
+    drop_ready(loop->always_ready, 0, &loop->always_ready_length, fildes);
+    if (always_length != loop->always_ready_length) {
+        return EVENT_LOOP_SUCCESS;
+    }
+
+    int ctl_check = epoll_ctl(loop->epoll_fildes, EPOLL_CTL_DEL, fildes, NULL);
+    if (ctl_check == ERROR_EPOLL) {
+        perror("Can't stop watching input");
+        return EVENT_LOOP_ERROR;
+    }
+    return EVENT_LOOP_SUCCESS;
+}
+
+int event_loop_set_deadline(event_loop *loop, long seconds) {
+    struct itimerspec deadline;
+    memset(&deadline, 0, sizeof(deadline));
+    int clock_check = clock_gettime(CLOCK_MONOTONIC, &deadline.it_value);
+    if (clock_check == ERROR_CLOCK) {
+        perror("Can't get time");
+        return EVENT_LOOP_ERROR;
+    }
+    deadline.it_value.tv_sec += seconds;
+
+    int set_check = timerfd_settime(loop->timer_fildes, TFD_TIMER_ABSTIME, &deadline, NULL);
+    if (set_check == ERROR_TIMERFD) {
+        perror("Can't set deadline");
+        return EVENT_LOOP_ERROR;
+    }
+    loop->deadline_passed = FALSE;
+    return EVENT_LOOP_SUCCESS;
+}
+
+int event_loop_wait(event_loop *loop, int *fildes) {
+    while (TRUE) {
+        if (loop->interrupted == TRUE) {
+            loop->interrupted = FALSE;
+            return EVENT_INTERRUPT;
+        }
+        if (loop->ready_next < loop->ready_length) {
+            *fildes = loop->ready[loop->ready_next++];
+            return EVENT_INPUT;
+        }
+        if (loop->deadline_passed == TRUE) {
+            loop->deadline_passed = FALSE;
+            return EVENT_TIMEOUT;
+        }
+
+        struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+        int timeout = (loop->always_ready_length > 0) ? POLL_ONLY : NO_TIMEOUT;
+        int count = epoll_wait(loop->epoll_fildes, events, EVENT_LOOP_MAX_EVENTS, timeout);
+        if (count == ERROR_EPOLL) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't wait for input");
+            return EVENT_LOOP_ERROR;
+        }
+
+        loop->ready_length = 0;
+        loop->ready_next = 0;
+        for (int i = 0; i < count; i++) {
+            int ready_fildes = events[i].data.fd;
+            if (ready_fildes == loop->signal_fildes) {
+                read_signals(loop);
+            } else if (ready_fildes == loop->timer_fildes) {
+                read_timer(loop);
+            } else {
+                loop->ready[loop->ready_length++] = ready_fildes;
+            }
+        }
+        if (loop->interrupted == FALSE && loop->ready_length == 0 && loop->always_ready_length > 0) {
+            *fildes = loop->always_ready[0];
+            return EVENT_INPUT;
+        }
+    }
+}
+
+void event_loop_destroy(event_loop *loop) {
+    if (loop == NULL) {
+        return;
+    }
+    if (loop->epoll_fildes != NO_FILDES) {
+        close(loop->epoll_fildes);
+    }
+    if (loop->timer_fildes != NO_FILDES) {
+        close(loop->timer_fildes);
+    }
+    if (loop->signal_fildes != NO_FILDES) {
+        close(loop->signal_fildes);
+    }
+    sigprocmask(SIG_SETMASK, &loop->old_mask, NULL);
+    free(loop);
+}
@@ -0,0 +1,37 @@
+#ifndef LAB6_EVENT_LOOP_H
+#define LAB6_EVENT_LOOP_H
+
+#include <signal.h>
+#include <stdint.h>
+
+#define EVENT_LOOP_ERROR -1
+#define EVENT_LOOP_SUCCESS 0
+
+#define EVENT_INPUT 1
+#define EVENT_TIMEOUT 2
+#define EVENT_INTERRUPT 3
+
+#define EVENT_LOOP_MAX_EVENTS 16
+
+typedef struct event_loop {
+    int epoll_fildes;
+    int timer_fildes;
+    int signal_fildes;
+    sigset_t old_mask;
+    int ready[EVENT_LOOP_MAX_EVENTS];
+    int ready_length;
+    int ready_next;
+    int always_ready[EVENT_LOOP_MAX_EVENTS];
+    int always_ready_length;
+    int deadline_passed;
+    int interrupted;
+} event_loop;
+
+event_loop *event_loop_create();
+int event_loop_add(event_loop *loop, int fildes);
+int event_loop_remove(event_loop *loop, int fildes);
+int event_loop_set_deadline(event_loop *loop, long seconds);
+int event_loop_wait(event_loop *loop, int *fildes);
+void event_loop_destroy(event_loop *loop);
+
+#endif
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include "file_dump.h"
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define ERROR_TRANSFER -1
+#define ERROR_FSTAT -1
+#define ERROR_POLL -1
+#define TRANSFER_EOF 0
+#define TRANSFER_UNSUPPORTED 1
+#define MAX_TRANSFER_SIZE 0x7ffff000
+#define NO_FLAGS 0
+#define NO_TIMEOUT -1
+
+typedef ssize_t (*transfer_function)(int in_fildes, off_t *offset, int out_fildes, size_t length);
+
+static ssize_t transfer_copy_file_range(int in_fildes, off_t *offset, int out_fildes, size_t length) {
+    return copy_file_range(in_fildes, offset, out_fildes, NULL, length, NO_FLAGS);
+}
+
+static ssize_t transfer_splice(int in_fildes, off_t *offset, int out_fildes, size_t length) {
+    return splice(in_fildes, offset, out_fildes, NULL, length, SPLICE_F_MOVE);
+}
+
+static ssize_t transfer_sendfile(int in_fildes, off_t *offset, int out_fildes, size_t length) {
+    return sendfile(out_fildes, in_fildes, offset, length);
+}
+
+static int wait_writable(int fildes) {
+    struct pollfd poll_fildes;
+    poll_fildes.fd = fildes;
+    poll_fildes.events = POLLOUT;
+    while (poll(&poll_fildes, 1, NO_TIMEOUT) == ERROR_POLL) {
+        if (errno != EINTR) {
+            perror("Can't wait for console");
+            return DUMP_ERROR;
+        }
+    }
+    return DUMP_SUCCESS;
+}
+
+static int report_short_copy() {
+    fprintf(stderr, "Can't write file to console: File got shorter while copying\n");
+    return DUMP_ERROR;
+}
+
+static int is_unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == EBADF;
+}
+
+static int transfer(transfer_function function, int in_fildes, off_t *offset, off_t end, int out_fildes) {
+    int started = 0;
+    while (*offset < end) {
+        size_t length = (end - *offset < MAX_TRANSFER_SIZE) ? end - *offset : MAX_TRANSFER_SIZE;
+        ssize_t transferred = function(in_fildes, offset, out_fildes, length);
+        if (transferred == ERROR_TRANSFER) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                if (wait_writable(out_fildes) == DUMP_ERROR) {
+                    return DUMP_ERROR;
+                }
+                continue;
+            }
+            if (!started && is_unsupported(errno)) {
+                return TRANSFER_UNSUPPORTED;
+            }
+            perror("Can't write file to console");
+            return DUMP_ERROR;
+        }
+        if (transferred == TRANSFER_EOF) {
+            /* some filesystems copy nothing instead of failing; let the next method try */
+            return started ? report_short_copy() : TRANSFER_UNSUPPORTED;
+        }
+        started = 1;
+    }
+    return DUMP_SUCCESS;
+}
+
+static int copy_with_buffer(int in_fildes, off_t *offset, off_t end, int out_fildes) {
+    char *buf = (char *) malloc(DUMP_BUFFER_SIZE);
+    if (buf == NULL) {
+        perror("Can't write file to console");
+        return DUMP_ERROR;
+    }
+
+    while (*offset < end) {
+        size_t length = (end - *offset < DUMP_BUFFER_SIZE) ? end - *offset : DUMP_BUFFER_SIZE;
+        ssize_t bytes_read = pread(in_fildes, buf, length, *offset);
+        if (bytes_read == ERROR_TRANSFER) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read from file");
+            free(buf);
+            return DUMP_ERROR;
+        }
+        if (bytes_read == TRANSFER_EOF) {
+            free(buf);
+            return report_short_copy();
+        }
+
+        char *ptr = buf;
+        size_t rest = bytes_read;
+        while (rest > 0) {
+            ssize_t written = write(out_fildes, ptr, rest);
+            if (written == ERROR_TRANSFER) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN && wait_writable(out_fildes) == DUMP_SUCCESS) {
+                    continue;
+                }
+                perror("Can't write file to console");
+                free(buf);
+                return DUMP_ERROR;
+            }
+            ptr += written;
+            rest -= written;
+        }
+        *offset += bytes_read;
+    }
+
+    free(buf);
+    return DUMP_SUCCESS;
+}
+
+int dump_file(int in_fildes, off_t offset, off_t length, int out_fildes) {
+    struct stat out_stat;
+    int fstat_check = fstat(out_fildes, &out_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get console stat");
+        return DUMP_ERROR;
+    }
+
+    off_t end = offset + length;
+    int transfer_check = TRANSFER_UNSUPPORTED;
+    if (S_ISREG(out_stat.st_mode)) {
+        transfer_check = transfer(transfer_copy_file_range, in_fildes, &offset, end, out_fildes);
+    } else if (S_ISFIFO(out_stat.st_mode)) {
+        transfer_check = transfer(transfer_splice, in_fildes, &offset, end, out_fildes);
+    }
+    if (transfer_check == TRANSFER_UNSUPPORTED) {
+        transfer_check = transfer(transfer_sendfile, in_fildes, &offset, end, out_fildes);
+    }
+    if (transfer_check == TRANSFER_UNSUPPORTED) {
+        transfer_check = copy_with_buffer(in_fildes, &offset, end, out_fildes);
+    }
+    return transfer_check;
+}
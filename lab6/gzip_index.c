@@ -0,0 +1,564 @@
+#include "gzip_index.h"
+#include "line_table.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_PREAD -1
+#define ERROR_OPEN -1
+#define ERROR_FSTAT -1
+#define ERROR_WRITE -1
+#define ERROR_CLOSE -1
+#define ERROR_RENAME -1
+#define ERROR_FCHMOD -1
+#define PREAD_EOF 0
+#define TRUE 1
+#define FALSE 0
+#define STRING_EQUAL 0
+#define ANY_ADDRESS 0
+#define TO_END_OF_FILE 0
+#define INIT_CHECKPOINTS_SIZE 16
+#define INIT_TABLE_SIZE 1024
+#define AUTO_HEADER_WINDOW_BITS (15 + 32)
+#define RAW_WINDOW_BITS -15
+#define LAST_BLOCK_FLAG 64
+#define BLOCK_END_FLAG 128
+#define BITS_MASK 7
+#define BITS_PER_BYTE 8
+#define GZIP_MAGIC_1 0x1f
+#define GZIP_MAGIC_2 0x8b
+#define GZIP_MAGIC_SIZE 2
+#define TMP_SUFFIX_SIZE 32
+#define TMP_TEMPLATE ".XXXXXX"
+#define INDEX_FILE_MODE 0644
+
+static ssize_t read_input(int fildes, unsigned char *buf, size_t size, uint64_t offset) {
+    while (TRUE) {
+        ssize_t bytes_read = pread(fildes, buf, size, offset);
+        if (bytes_read == ERROR_PREAD && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read == ERROR_PREAD) {
+            perror("Can't read compressed file");
+        }
+        return bytes_read;
+    }
+}
+
+int is_gzip_file(int fildes) {
+    unsigned char magic[GZIP_MAGIC_SIZE];
+    ssize_t bytes_read = read_input(fildes, magic, GZIP_MAGIC_SIZE, 0);
+    return bytes_read == GZIP_MAGIC_SIZE && magic[0] == GZIP_MAGIC_1 && magic[1] == GZIP_MAGIC_2;
+}
+
+static int add_line(gzip_index *index, long long *table_size, uint64_t line_offset, uint64_t line_length) {
+    if (index->length == *table_size) {
+        line_info *ptr = line_table_grow(index->table, 2 * (*table_size));
+        if (ptr == NULL) {
+            return GZIP_INDEX_ERROR;
+        }
+        index->table = ptr;
+        (*table_size) *= 2;
+    }
+    index->table[index->length].offset = line_offset;
+    index->table[index->length].length = line_length;
+    index->length++;
+    return GZIP_INDEX_SUCCESS;
+}
+
+static int add_checkpoint(gzip_index *index, long long *checkpoints_size, uint64_t out, uint64_t in, int bits,
+                          const unsigned char *window, size_t window_end) {
+    if (index->checkpoints_length == *checkpoints_size) {
+        gzip_checkpoint *ptr = (gzip_checkpoint *) realloc(index->checkpoints, 2 * (*checkpoints_size) * sizeof(gzip_checkpoint));
+        if (ptr == NULL) {
+            perror("Can't add checkpoint");
+            return GZIP_INDEX_ERROR;
+        }
+        index->checkpoints = ptr;
+        (*checkpoints_size) *= 2;
+    }
+
+    gzip_checkpoint *checkpoint = &index->checkpoints[index->checkpoints_length++];
+    memset(checkpoint, 0, sizeof(gzip_checkpoint));
+    checkpoint->out = out;
+    checkpoint->in = in;
+    checkpoint->bits = bits;
+    if (bits != GZIP_MEMBER_START) {
+        memcpy(checkpoint->window, window + window_end, GZIP_WINDOW_SIZE - window_end);
+        memcpy(checkpoint->window + GZIP_WINDOW_SIZE - window_end, window, window_end);
+    }
+    return GZIP_INDEX_SUCCESS;
+}
+
+static int scan_lines(gzip_index *index, long long *table_size, uint64_t *line_offset,
+                      const unsigned char *output, size_t length, uint64_t output_offset) {
+    const unsigned char *c = output, *end = output + length;
+    const unsigned char *new_line;
+    while ((new_line = (const unsigned char *) memchr(c, '\n', end - c)) != NULL) {
+        uint64_t new_line_offset = output_offset + (new_line - output);
+        if (add_line(index, table_size, *line_offset, new_line_offset - *line_offset) == GZIP_INDEX_ERROR) {
+            return GZIP_INDEX_ERROR;
+        }
+        *line_offset = new_line_offset + 1;
+        c = new_line + 1;
+    }
+    return GZIP_INDEX_SUCCESS;
+}
+
+static int next_member_follows(int fildes, z_stream *stream, uint64_t in) {
+    if (stream->avail_in >= GZIP_MAGIC_SIZE) {
+        return stream->next_in[0] == GZIP_MAGIC_1 && stream->next_in[1] == GZIP_MAGIC_2;
+    }
+    unsigned char magic[GZIP_MAGIC_SIZE];
+    return read_input(fildes, magic, GZIP_MAGIC_SIZE, in) == GZIP_MAGIC_SIZE
+        && magic[0] == GZIP_MAGIC_1 && magic[1] == GZIP_MAGIC_2;
+}
+
+static int inflate_file(int fildes, gzip_index *index, z_stream *stream, unsigned char *input, unsigned char *window) {
+    long long checkpoints_size = INIT_CHECKPOINTS_SIZE, table_size = INIT_TABLE_SIZE;
+    uint64_t total_in = 0, total_out = 0, last = 0, read_offset = 0, line_offset = 0;
+    size_t window_end = 0;
+
+    if (add_checkpoint(index, &checkpoints_size, 0, 0, GZIP_MEMBER_START, window, 0) == GZIP_INDEX_ERROR) {
+        return GZIP_INDEX_ERROR;
+    }
+
+    while (TRUE) {
+        if (stream->avail_in == 0) {
+            ssize_t bytes_read = read_input(fildes, input, GZIP_INPUT_SIZE, read_offset);
+            if (bytes_read == ERROR_PREAD) {
+                return GZIP_INDEX_ERROR;
+            }
+            if (bytes_read == PREAD_EOF) {
+                fprintf(stderr, "Can't index compressed file: Unexpected end of file\n");
+                return GZIP_INDEX_ERROR;
+            }
+            read_offset += bytes_read;
+            stream->next_in = input;
+            stream->avail_in = bytes_read;
+        }
+
+        if (window_end == GZIP_WINDOW_SIZE) {
+            window_end = 0;
+        }
+        stream->next_out = window + window_end;
+        stream->avail_out = GZIP_WINDOW_SIZE - window_end;
+
+        uint64_t avail_in = stream->avail_in;
+        int ret = inflate(stream, Z_BLOCK);
+        size_t produced = GZIP_WINDOW_SIZE - window_end - stream->avail_out;
+        total_in += avail_in - stream->avail_in;
+        if (scan_lines(index, &table_size, &line_offset, window + window_end, produced, total_out) == GZIP_INDEX_ERROR) {
+            return GZIP_INDEX_ERROR;
+        }
+        total_out += produced;
+        window_end += produced;
+
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+            fprintf(stderr, "Can't index compressed file: %s\n", (stream->msg != NULL) ? stream->msg : "invalid data");
+            return GZIP_INDEX_ERROR;
+        }
+
+        if (ret == Z_STREAM_END) {
+            if (!next_member_follows(fildes, stream, total_in)) {
+                break;
+            }
+            inflateReset(stream);
+            if (add_checkpoint(index, &checkpoints_size, total_out, total_in, GZIP_MEMBER_START, window, 0) == GZIP_INDEX_ERROR) {
+                return GZIP_INDEX_ERROR;
+            }
+            last = total_out;
+            continue;
+        }
+
+        if ((stream->data_type & BLOCK_END_FLAG) && !(stream->data_type & LAST_BLOCK_FLAG) && total_out - last >= index->span) {
+            if (add_checkpoint(index, &checkpoints_size, total_out, total_in, stream->data_type & BITS_MASK,
+                               window, window_end % GZIP_WINDOW_SIZE) == GZIP_INDEX_ERROR) {
+                return GZIP_INDEX_ERROR;
+            }
+            last = total_out;
+        }
+    }
+
+    index->size = total_out;
+    return add_line(index, &table_size, line_offset, total_out - line_offset);
+}
+
+gzip_index *gzip_index_build(int fildes, uint64_t span) {
+    gzip_index *index = (gzip_index *) calloc(1, sizeof(gzip_index));
+    unsigned char *input = (unsigned char *) malloc(GZIP_INPUT_SIZE);
+    unsigned char *window = (unsigned char *) calloc(GZIP_WINDOW_SIZE, 1);
+    if (index != NULL) {
+        index->span = span;
+        index->checkpoints = (gzip_checkpoint *) malloc(INIT_CHECKPOINTS_SIZE * sizeof(gzip_checkpoint));
+    }
+    if (index == NULL || input == NULL || window == NULL || index->checkpoints == NULL) {
+        perror("Can't create compressed file index");
+        gzip_index_destroy(index);
+        free(input);
+        free(window);
+        return NULL;
+    }
+    index->table = line_table_create(INIT_TABLE_SIZE);
+    if (index->table == NULL) {
+        gzip_index_destroy(index);
+        free(input);
+        free(window);
+        return NULL;
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int init_check = inflateInit2(&stream, AUTO_HEADER_WINDOW_BITS);
+    int result = (init_check == Z_OK) ? inflate_file(fildes, index, &stream, input, window) : GZIP_INDEX_ERROR;
+    if (init_check == Z_OK) {
+        inflateEnd(&stream);
+    } else {
+        fprintf(stderr, "Can't initialize inflate\n");
+    }
+
+    free(input);
+    free(window);
+    if (result == GZIP_INDEX_ERROR) {
+        gzip_index_destroy(index);
+        return NULL;
+    }
+    return index;
+}
+
+static char *index_name(const char *file_name) {
+    size_t size = strlen(file_name) + strlen(GZIP_INDEX_SUFFIX) + TMP_SUFFIX_SIZE;
+    char *name = (char *) malloc(size);
+    if (name == NULL) {
+        perror("Can't allocate compressed index name");
+        return NULL;
+    }
+    snprintf(name, size, "%s%s", file_name, GZIP_INDEX_SUFFIX);
+    return name;
+}
+
+static int header_matches(const gzip_index_header *header, const struct stat *file_stat, size_t map_size) {
+    if (memcmp(header->magic, GZIP_INDEX_MAGIC, sizeof(GZIP_INDEX_MAGIC)) != STRING_EQUAL
+            || header->version != GZIP_INDEX_VERSION
+            || header->entry_size != sizeof(gzip_checkpoint)) {
+        return FALSE;
+    }
+    if (header->file_device != (uint64_t) file_stat->st_dev
+            || header->file_inode != (uint64_t) file_stat->st_ino
+            || header->file_size != (uint64_t) file_stat->st_size
+            || header->file_mtime_sec != (int64_t) file_stat->st_mtim.tv_sec
+            || header->file_mtime_nsec != (int64_t) file_stat->st_mtim.tv_nsec) {
+        return FALSE;
+    }
+    size_t body_size = map_size - sizeof(gzip_index_header);
+    if (header->checkpoints_length > body_size / sizeof(gzip_checkpoint)
+            || header->table_length > body_size / sizeof(line_info)) {
+        return FALSE;
+    }
+    return map_size == sizeof(gzip_index_header) + header->checkpoints_length * sizeof(gzip_checkpoint)
+        + header->table_length * sizeof(line_info);
+}
+
+gzip_index *gzip_index_load(const char *file_name, const struct stat *file_stat) {
+    char *name = index_name(file_name);
+    if (name == NULL) {
+        return NULL;
+    }
+    int fildes = open(name, O_RDONLY);
+    free(name);
+    if (fildes == ERROR_OPEN) {
+        if (errno != ENOENT) {
+            perror("Can't open compressed file index");
+        }
+        return NULL;
+    }
+
+    struct stat index_stat;
+    int fstat_check = fstat(fildes, &index_stat);
+    if (fstat_check == ERROR_FSTAT || (size_t) index_stat.st_size < sizeof(gzip_index_header)) {
+        close(fildes);
+        return NULL;
+    }
+    size_t map_size = index_stat.st_size;
+    void *addr = mmap(ANY_ADDRESS, map_size, PROT_READ, MAP_SHARED, fildes, 0);
+    close(fildes);
+    if (addr == MAP_FAILED) {
+        perror("Can't map compressed file index");
+        return NULL;
+    }
+
+    const gzip_index_header *header = (const gzip_index_header *) addr;
+    gzip_index *index = (header_matches(header, file_stat, map_size)) ? (gzip_index *) calloc(1, sizeof(gzip_index)) : NULL;
+    if (index == NULL) {
+        munmap(addr, map_size);
+        return NULL;
+    }
+
+    index->addr = addr;
+    index->map_size = map_size;
+    index->span = header->span;
+    index->size = header->size;
+    index->checkpoints_length = header->checkpoints_length;
+    index->length = header->table_length;
+    index->checkpoints = (gzip_checkpoint *) ((char *) addr + sizeof(gzip_index_header));
+    index->table = (line_info *) (index->checkpoints + index->checkpoints_length);
+    return index;
+}
+
+static int write_all(int fildes, const void *buf, size_t length) {
+    const char *ptr = (const char *) buf;
+    while (length > 0) {
+        ssize_t written = write(fildes, ptr, length);
+        if (written == ERROR_WRITE) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't write compressed file index");
+            return GZIP_INDEX_ERROR;
+        }
+        ptr += written;
+        length -= written;
+    }
+    return GZIP_INDEX_SUCCESS;
+}
+
+int gzip_index_save(const char *file_name, const struct stat *file_stat, const gzip_index *index) {
+    char *name = index_name(file_name);
+    char *tmp_name = index_name(file_name);
+    if (name == NULL || tmp_name == NULL) {
+        free(name);
+        free(tmp_name);
+        return GZIP_INDEX_ERROR;
+    }
+    snprintf(tmp_name + strlen(name), TMP_SUFFIX_SIZE, TMP_TEMPLATE);
+
+    int fildes = mkstemp(tmp_name);
+    if (fildes == ERROR_OPEN || fchmod(fildes, INDEX_FILE_MODE) == ERROR_FCHMOD) {
+        perror("Can't create compressed file index");
+        if (fildes != ERROR_OPEN) {
+            close(fildes);
+            unlink(tmp_name);
+        }
+        free(name);
+        free(tmp_name);
+        return GZIP_INDEX_ERROR;
+    }
+
+    gzip_index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GZIP_INDEX_MAGIC, sizeof(GZIP_INDEX_MAGIC));
+    header.version = GZIP_INDEX_VERSION;
+    header.entry_size = sizeof(gzip_checkpoint);
+    header.file_device = file_stat->st_dev;
+    header.file_inode = file_stat->st_ino;
+    header.file_size = file_stat->st_size;
+    header.file_mtime_sec = file_stat->st_mtim.tv_sec;
+    header.file_mtime_nsec = file_stat->st_mtim.tv_nsec;
+    header.span = index->span;
+    header.size = index->size;
+    header.checkpoints_length = index->checkpoints_length;
+    header.table_length = index->length;
+
+    int result = write_all(fildes, &header, sizeof(header));
+    if (result == GZIP_INDEX_SUCCESS) {
+        result = write_all(fildes, index->checkpoints, index->checkpoints_length * sizeof(gzip_checkpoint));
+    }
+    if (result == GZIP_INDEX_SUCCESS) {
+        result = write_all(fildes, index->table, index->length * sizeof(line_info));
+    }
+    if (close(fildes) == ERROR_CLOSE) {
+        perror("Can't close compressed file index");
+        result = GZIP_INDEX_ERROR;
+    }
+    if (result == GZIP_INDEX_SUCCESS && rename(tmp_name, name) == ERROR_RENAME) {
+        perror("Can't replace compressed file index");
+        result = GZIP_INDEX_ERROR;
+    }
+    if (result == GZIP_INDEX_ERROR) {
+        unlink(tmp_name);
+    }
+
+    free(name);
+    free(tmp_name);
+    return result;
+}
+
+void gzip_index_destroy(gzip_index *index) {
+    if (index == NULL) {
+        return;
+    }
+    if (index->addr != NULL) {
+        munmap(index->addr, index->map_size);
+    } else {
+        free(index->checkpoints);
+        line_table_free(index->table);
+    }
+    free(index);
+}
+
+gzip_reader *gzip_reader_create(const gzip_index *index, int fildes) {
+    gzip_reader *reader = (gzip_reader *) calloc(1, sizeof(gzip_reader));
+    if (reader == NULL) {
+        perror("Can't create compressed file reader");
+        return NULL;
+    }
+    reader->index = index;
+    reader->fildes = fildes;
+    reader->active = FALSE;
+    return reader;
+}
+
+static const gzip_checkpoint *find_checkpoint(const gzip_index *index, uint64_t offset) {
+    long long low = 0, high = index->checkpoints_length - 1;
+    while (low < high) {
+        long long middle = (low + high + 1) / 2;
+        if (index->checkpoints[middle].out <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return &index->checkpoints[low];
+}
+
+static int start_at(gzip_reader *reader, const gzip_checkpoint *checkpoint) {
+    if (reader->active == TRUE) {
+        inflateEnd(&reader->stream);
+        reader->active = FALSE;
+    }
+    memset(&reader->stream, 0, sizeof(z_stream));
+
+    int member_start = (checkpoint->bits == GZIP_MEMBER_START);
+    int init_check = inflateInit2(&reader->stream, member_start ? AUTO_HEADER_WINDOW_BITS : RAW_WINDOW_BITS);
+    if (init_check != Z_OK) {
+        fprintf(stderr, "Can't initialize inflate\n");
+        return GZIP_INDEX_ERROR;
+    }
+    reader->active = TRUE;
+    reader->out = checkpoint->out;
+    reader->in = checkpoint->in;
+    if (member_start) {
+        return GZIP_INDEX_SUCCESS;
+    }
+
+    if (checkpoint->bits > 0) {
+        unsigned char byte;
+        if (read_input(reader->fildes, &byte, 1, checkpoint->in - 1) != 1) {
+            fprintf(stderr, "Can't read compressed file: Unexpected end of file\n");
+            return GZIP_INDEX_ERROR;
+        }
+        inflatePrime(&reader->stream, checkpoint->bits, byte >> (BITS_PER_BYTE - checkpoint->bits));
+    }
+    inflateSetDictionary(&reader->stream, checkpoint->window, GZIP_WINDOW_SIZE);
+    return GZIP_INDEX_SUCCESS;
+}
+
+static const gzip_checkpoint *member_at(const gzip_index *index, uint64_t out) {
+    const gzip_checkpoint *checkpoint = find_checkpoint(index, out);
+    while (checkpoint > index->checkpoints && (checkpoint - 1)->out == out) {
+        checkpoint--;
+    }
+    for (; checkpoint < index->checkpoints + index->checkpoints_length && checkpoint->out == out; checkpoint++) {
+        if (checkpoint->bits == GZIP_MEMBER_START) {
+            return checkpoint;
+        }
+    }
+    return NULL;
+}
+
+static int inflate_into(gzip_reader *reader, unsigned char *buf, size_t length) {
+    while (length > 0) {
+        if (reader->stream.avail_in == 0) {
+            ssize_t bytes_read = read_input(reader->fildes, reader->input, GZIP_INPUT_SIZE, reader->in);
+            if (bytes_read == ERROR_PREAD) {
+                return GZIP_INDEX_ERROR;
+            }
+            if (bytes_read == PREAD_EOF) {
+                fprintf(stderr, "Can't read compressed file: Unexpected end of file\n");
+                return GZIP_INDEX_ERROR;
+            }
+            reader->in += bytes_read;
+            reader->stream.next_in = reader->input;
+            reader->stream.avail_in = bytes_read;
+        }
+
+        reader->stream.next_out = buf;
+        reader->stream.avail_out = (length > UINT32_MAX) ? UINT32_MAX : length;
+        uInt avail_out = reader->stream.avail_out;
+        int ret = inflate(&reader->stream, Z_NO_FLUSH);
+        size_t produced = avail_out - reader->stream.avail_out;
+        reader->out += produced;
+        buf += produced;
+        length -= produced;
+
+        if (ret == Z_STREAM_END && length > 0) {
+            const gzip_checkpoint *member = member_at(reader->index, reader->out);
+            if (member == NULL || start_at(reader, member) == GZIP_INDEX_ERROR) {
+                fprintf(stderr, "Can't read compressed file: Unexpected end of stream\n");
+                return GZIP_INDEX_ERROR;
+            }
+        } else if (ret != Z_OK && ret != Z_STREAM_END && !(ret == Z_BUF_ERROR && produced > 0)) {
+            fprintf(stderr, "Can't read compressed file: %s\n", (reader->stream.msg != NULL) ? reader->stream.msg : "invalid data");
+            return GZIP_INDEX_ERROR;
+        }
+    }
+    return GZIP_INDEX_SUCCESS;
+}
+
+int gzip_reader_read(gzip_reader *reader, uint64_t offset, size_t length, char *buf) {
+    if (reader == NULL || buf == NULL || offset + length > reader->index->size) {
+        fprintf(stderr, "Can't read compressed file: Invalid argument(s)\n");
+        return GZIP_INDEX_ERROR;
+    }
+
+    const gzip_checkpoint *checkpoint = find_checkpoint(reader->index, offset);
+    if (reader->active == FALSE || offset < reader->out || checkpoint->out > reader->out) {
+        if (start_at(reader, checkpoint) == GZIP_INDEX_ERROR) {
+            return GZIP_INDEX_ERROR;
+        }
+    }
+
+    while (reader->out < offset) {
+        uint64_t skip = offset - reader->out;
+        size_t part = (skip < GZIP_WINDOW_SIZE) ? skip : GZIP_WINDOW_SIZE;
+        if (inflate_into(reader, reader->discard, part) == GZIP_INDEX_ERROR) {
+            reader->active = FALSE;
+            inflateEnd(&reader->stream);
+            return GZIP_INDEX_ERROR;
+        }
+    }
+    if (inflate_into(reader, (unsigned char *) buf, length) == GZIP_INDEX_ERROR) {
+        reader->active = FALSE;
+        inflateEnd(&reader->stream);
+        return GZIP_INDEX_ERROR;
+    }
+    return GZIP_INDEX_SUCCESS;
+}
+
+void gzip_reader_prefetch(gzip_reader *reader, uint64_t offset, size_t length) {
+    const gzip_index *index = reader->index;
+    if (offset >= index->size) {
+        return;
+    }
+
+    /* the compressed bytes a read of the range would inflate, from its checkpoint on */
+    const gzip_checkpoint *first = find_checkpoint(index, offset);
+    const gzip_checkpoint *last = find_checkpoint(index, offset + length);
+    off_t begin = (first->in > 0) ? first->in - 1 : 0;
+    off_t span = (last + 1 < index->checkpoints + index->checkpoints_length) ? (last + 1)->in - begin : TO_END_OF_FILE;
+    posix_fadvise(reader->fildes, begin, span, POSIX_FADV_WILLNEED);
+}
+
+void gzip_reader_destroy(gzip_reader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->active == TRUE) {
+        inflateEnd(&reader->stream);
+    }
+    free(reader);
+}
@@ -0,0 +1,79 @@
+#ifndef LAB6_GZIP_INDEX_H
+#define LAB6_GZIP_INDEX_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "line_info.h"
+
+#define GZIP_INDEX_ERROR -1
+#define GZIP_INDEX_SUCCESS 0
+
+#define GZIP_WINDOW_SIZE 32768
+#define GZIP_INPUT_SIZE 16384
+#define GZIP_DEFAULT_SPAN (1024 * 1024)
+#define GZIP_MEMBER_START -1
+#define GZIP_INDEX_MAGIC "GZLINES"
+#define GZIP_INDEX_MAGIC_SIZE 8
+#define GZIP_INDEX_VERSION 1
+#define GZIP_INDEX_SUFFIX ".gzidx"
+
+typedef struct gzip_checkpoint {
+    uint64_t out;
+    uint64_t in;
+    int32_t bits;
+    uint32_t reserved;
+    unsigned char window[GZIP_WINDOW_SIZE];
+} gzip_checkpoint;
+
+typedef struct gzip_index_header {
+    char magic[GZIP_INDEX_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t file_device;
+    uint64_t file_inode;
+    uint64_t file_size;
+    int64_t file_mtime_sec;
+    int64_t file_mtime_nsec;
+    uint64_t span;
+    uint64_t size;
+    uint64_t checkpoints_length;
+    uint64_t table_length;
+} gzip_index_header;
+
+typedef struct gzip_index {
+    gzip_checkpoint *checkpoints;
+    long long checkpoints_length;
+    line_info *table;
+    long long length;
+    uint64_t size;
+    uint64_t span;
+    void *addr;
+    size_t map_size;
+} gzip_index;
+
+typedef struct gzip_reader {
+    const gzip_index *index;
+    int fildes;
+    z_stream stream;
+    int active;
+    uint64_t out;
+    uint64_t in;
+    unsigned char input[GZIP_INPUT_SIZE];
+    unsigned char discard[GZIP_WINDOW_SIZE];
+} gzip_reader;
+
+int is_gzip_file(int fildes);
+
+gzip_index *gzip_index_build(int fildes, uint64_t span);
+gzip_index *gzip_index_load(const char *file_name, const struct stat *file_stat);
+int gzip_index_save(const char *file_name, const struct stat *file_stat, const gzip_index *index);
+void gzip_index_destroy(gzip_index *index);
+
+gzip_reader *gzip_reader_create(const gzip_index *index, int fildes);
+int gzip_reader_read(gzip_reader *reader, uint64_t offset, size_t length, char *buf);
+void gzip_reader_prefetch(gzip_reader *reader, uint64_t offset, size_t length);
+void gzip_reader_destroy(gzip_reader *reader);
+
+#endif
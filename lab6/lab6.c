@@ -1,11 +1,20 @@
 #include <sys/types.h>
-#include <sys/select.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include "line_info.h"
+#include "index_cache.h"
+#include "line_table.h"
+#include "console_output.h"
+#include "file_dump.h"
+#include "line_fetch.h"
+#include "gzip_index.h"
+#include "event_loop.h"
+#include "line_prefetch.h"
 
 extern int errno;
 
@@ -15,14 +24,18 @@ extern int errno;
 #define ERROR_WRITE -1
 #define ERROR_ADD_TO_TABLE -1
 #define ERROR_GET_LINE_NUMBER -1
-#define ERROR_LSEEK -1
 #define ERROR_ADD_TO_TABLE -1
 #define ERROR_PRINT_FILE -1
 #define ERROR_PRINT_LINES -1
 #define ERROR_PRINT_LINE -1
-#define ERROR_SELECT -1
+#define ERROR_WAIT -1
 #define ERROR_STRTOLL -1
 #define ERROR_FILL_TABLE -1
+#define ERROR_FSTAT -1
+#define ERROR_SPILL -1
+#define ERROR_SYSCONF -1
+#define ERROR_ANSWER_LINE_FILE -1
+#define ERROR_OPEN_GZIP -1
 
 #define NO_ERROR 0
 #define SUCCESS_OPEN_FILE 0
@@ -34,39 +47,53 @@ extern int errno;
 #define SUCCESS_PRINT_FILE 0
 #define SUCCESS_PRINT_LINES 0
 #define SUCCESS_PRINT_LINE 0
-#define SUCCESS_SELECT 1
+#define SUCCESS_WAIT 1
 #define SUCCESS_STRTOLL 0
 #define SUCCESS_FILL_TABLE 0
+#define SUCCESS_SPILL 0
+#define SUCCESS_ANSWER_LINE_FILE 0
+#define SUCCESS_OPEN_GZIP 0
 
 #define GET_LINE_NUMBER_TIMEOUT 2
+#define GET_LINE_NUMBER_INTERRUPTED 3
 #define INVALID_LINE_NUMBER_INPUT 0
-#define SELECT_NO_REACTION 0
+#define WAIT_TIMEOUT 0
+#define WAIT_INTERRUPTED 2
 #define READ_TIMEOUT 2
 #define READ_NOTHING 1
+#define READ_INTERRUPTED 3
 
-#define NULL_WRITEFDS NULL
-#define NULL_ERRORFDS NULL
 #define STRING_EQUAL 0
 #define READ_EOF 0
 #define TABLE_INIT_SIZE 100
-#define READ_INIT -1
 #define INPUT_SIZE 128
-#define BUFFER_SIZE 256
 #define NOT_STOP_INPUT 1
 #define TRUE 1
 #define FALSE 0
 #define STOP_INPUT 0
 #define WITH_NEW_LINE 1
 #define WITHOUT_NEW_LINE 0
+#define LINE_CHUNK_SIZE (64 * 1024)
 #define DECIMAL_SYSTEM 10
-#define SELECT_MAX_FILDES_PLUS_1 1
 #define TIMEOUT_SEC 5
-#define TIMEOUT_USEC 0
-
-typedef struct line_info {
-    off_t offset;
-    size_t length;
-} line_info;
+#define NO_CONTROL -1
+#define CONTROL_ENV "LAB6_CONTROL"
+#define PREFETCH_STATS_ENV "LAB6_PREFETCH_STATS"
+#define FILE_START_POS 0
+#define STREAM_BUFFER_SIZE (1024 * 1024)
+#define NO_SPILL -1
+#define SPILL_NAME_SIZE 4096
+#define SPILL_TEMPLATE "%s/lab6-XXXXXX"
+#define DEFAULT_TMP_DIR "/tmp"
+#define LINE_FILE_ARG 2
+#define INIT_TEXT_SIZE 4096
+#define FETCH_BATCH_SIZE 4096
+#define SINGLE_THREAD 1
+
+typedef struct line_request {
+    long long line_num;
+    long long position;
+} line_request;
 
 int add_to_table(line_info **table, long long *table_size, long long *table_length, off_t line_offset, size_t line_length) {
     if (table == NULL || *table == NULL || table_size == NULL || table_length == NULL) {
@@ -75,9 +102,8 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
     }
 
     if (*table_length == *table_size) {
-        line_info *ptr = (line_info *) realloc(*table, 2 * (*table_size) * sizeof(line_info));
+        line_info *ptr = line_table_grow(*table, 2 * (*table_size));
         if (ptr == NULL) {
-            perror("Can't create table");
             return ERROR_ADD_TO_TABLE;
         }
         *table = ptr;
@@ -94,99 +120,146 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
     return SUCCESS_ADD_TO_TABLE;
 }
 
-int fill_table(int fildes, line_info **table, long long *size, long long *table_length) {
-    size_t line_length = 0, read_length = 1;
-    off_t line_offset = 0;
-    ssize_t read_check = READ_INIT;
-    char c;
+int fill_table(int fildes, int spill_fildes, line_info **table, long long *size, long long *table_length) {
+    off_t line_offset = 0, file_offset = 0;
+    char *buf = (char *) malloc(STREAM_BUFFER_SIZE);
+    if (buf == NULL) {
+        perror("Can't create table");
+        return ERROR_FILL_TABLE;
+    }
 
-    while (read_check != READ_EOF) {
-        read_check = read(fildes, &c, read_length);
-        if (read_check == ERROR_READ) {
+    while (TRUE) {
+        ssize_t bytes_read = read(fildes, buf, STREAM_BUFFER_SIZE);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
             perror("Can't read from file");
+            free(buf);
             return ERROR_FILL_TABLE;
         }
-        if (read_check != READ_EOF && c != '\n') {
-            line_length++;
-            continue;
+        if (bytes_read == READ_EOF) {
+            break;
         }
 
-        int add_check = add_to_table(table, size, table_length, line_offset, line_length);
-        if (add_check == ERROR_ADD_TO_TABLE) {
-            return ERROR_FILL_TABLE;
+        if (spill_fildes != NO_SPILL) {
+            int write_check = write_all(spill_fildes, buf, bytes_read);
+            if (write_check == OUTPUT_ERROR) {
+                perror("Can't write to backing file");
+                free(buf);
+                return ERROR_FILL_TABLE;
+            }
         }
 
-        line_length = 0;
-        line_offset = lseek(fildes, 0L, SEEK_CUR);
-        if (line_offset == ERROR_LSEEK) {
-            perror("Can't get/set position in file");
-            return ERROR_FILL_TABLE;
+        char *c = buf, *end = buf + bytes_read;
+        char *new_line;
+        while ((new_line = (char *) memchr(c, '\n', end - c)) != NULL) {
+            off_t new_line_offset = file_offset + (new_line - buf);
+            int add_check = add_to_table(table, size, table_length, line_offset, new_line_offset - line_offset);
+            if (add_check == ERROR_ADD_TO_TABLE) {
+                free(buf);
+                return ERROR_FILL_TABLE;
+            }
+            line_offset = new_line_offset + 1;
+            c = new_line + 1;
         }
+        file_offset += bytes_read;
+    }
+    free(buf);
+
+    int add_check = add_to_table(table, size, table_length, line_offset, file_offset - line_offset);
+    if (add_check == ERROR_ADD_TO_TABLE) {
+        return ERROR_FILL_TABLE;
     }
     return SUCCESS_FILL_TABLE;
 }
 
-line_info *create_table(int fildes, long long *table_length) {
+line_info *create_table(int fildes, int spill_fildes, long long expected_length, long long *table_length) {
     if (table_length == NULL) {
         fprintf(stderr, "Can't create table: Invalid argument\n");
         return NULL;
     }
 
-    long long size = TABLE_INIT_SIZE;
+    long long size = expected_length;
     *table_length = 0;
-    line_info *table = (line_info *) malloc(size * sizeof(line_info));
+    line_info *table = line_table_create(size);
     if (table == NULL) {
-        perror("Can't create table");
         return NULL;
     }
 
-    int fill_check = fill_table(fildes, &table, &size, table_length);
+    int fill_check = fill_table(fildes, spill_fildes, &table, &size, table_length);
     if (fill_check == ERROR_FILL_TABLE) {
-        free(table);
+        line_table_free(table);
         return NULL;
     }
 
     return table;
 }
 
+int is_streamed(int fildes, struct stat *file_stat) {
+    if (!S_ISREG(file_stat->st_mode)) {
+        return TRUE;
+    }
+    if (file_stat->st_size != 0) {
+        return FALSE;
+    }
+    char probe;
+    return pread(fildes, &probe, 1, FILE_START_POS) > 0;
+}
+
+int create_spill_file(int *spill_fildes) {
+    const char *tmp_dir = getenv("TMPDIR");
+    if (tmp_dir == NULL) {
+        tmp_dir = DEFAULT_TMP_DIR;
+    }
+
+    char name[SPILL_NAME_SIZE];
+    snprintf(name, SPILL_NAME_SIZE, SPILL_TEMPLATE, tmp_dir);
+    *spill_fildes = mkstemp(name);
+    if (*spill_fildes == ERROR_OPEN_FILE) {
+        perror("Can't create backing file");
+        return ERROR_SPILL;
+    }
+    unlink(name);
+    return SUCCESS_SPILL;
+}
+
 int write_to_console(const char *buf, size_t length, int new_line) {
-    ssize_t write_check = write(STDOUT_FILENO, buf, length);
-    if (write_check == ERROR_WRITE) {
+    struct iovec iov[2];
+    iov[0].iov_base = (void *) buf;
+    iov[0].iov_len = length;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+
+    int write_check = write_vector(STDOUT_FILENO, iov, (new_line == WITH_NEW_LINE) ? 2 : 1);
+    if (write_check == OUTPUT_ERROR) {
         perror("Can't write to console");
         return ERROR_WRITE;
     }
-    if (new_line == WITH_NEW_LINE) {
-        return write_to_console("\n", 1, WITHOUT_NEW_LINE);
-    }
     return SUCCESS_WRITE;
 }
 
-int wait_for_input() {
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(STDIN_FILENO, &readfds);
+int wait_for_input(event_loop *loop, int *fildes) {
+    int event = event_loop_wait(loop, fildes);
 
-    struct timeval timeout;
-    timeout.tv_sec = TIMEOUT_SEC;
-    timeout.tv_usec = TIMEOUT_USEC;
-
-    int select_check = select(SELECT_MAX_FILDES_PLUS_1, &readfds, NULL_WRITEFDS, NULL_ERRORFDS, &timeout);
-
-    if (select_check == ERROR_SELECT) {
-        perror("Select error");
-        return ERROR_SELECT;
+    if (event == EVENT_LOOP_ERROR) {
+        return ERROR_WAIT;
     }
-    if (select_check == SELECT_NO_REACTION) {
-        int write_check = write_to_console("Time is out!\n", 13, WITHOUT_NEW_LINE);
+    if (event == EVENT_INTERRUPT) {
+        int write_check = write_to_console("", 0, WITH_NEW_LINE);
         if (write_check == ERROR_WRITE) {
-            return ERROR_SELECT;
+            return ERROR_WAIT;
         }
-        return SELECT_NO_REACTION;
+        return WAIT_INTERRUPTED;
     }
-    if (FD_ISSET(STDIN_FILENO, &readfds) == FALSE) {
-        return SELECT_NO_REACTION;
+    if (event == EVENT_TIMEOUT) {
+        int write_check = write_to_console("Time is out!\n", 13, WITHOUT_NEW_LINE);
+        if (write_check == ERROR_WRITE) {
+            return ERROR_WAIT;
+        }
+        return WAIT_TIMEOUT;
     }
-    return SUCCESS_SELECT;
+    return SUCCESS_WAIT;
 }
 
 int validate_strtoll(char *endptr) {
@@ -211,46 +284,58 @@ int validate_strtoll(char *endptr) {
     return SUCCESS_STRTOLL;
 }
 
-int read_from_console(char *input, size_t size) {
-    int wait_check = wait_for_input();
-    if (wait_check == ERROR_SELECT) {
+int read_from_console(event_loop *loop, char *input, size_t size) {
+    int fildes;
+    int wait_check = wait_for_input(loop, &fildes);
+    if (wait_check == ERROR_WAIT) {
         return ERROR_READ;
     }
-    if (wait_check == SELECT_NO_REACTION) {
+    if (wait_check == WAIT_TIMEOUT) {
         return READ_TIMEOUT;
     }
+    if (wait_check == WAIT_INTERRUPTED) {
+        return READ_INTERRUPTED;
+    }
 
-    ssize_t bytes_read = read(STDIN_FILENO, input, size);
+    ssize_t bytes_read = read(fildes, input, size);
     if (bytes_read == ERROR_READ) {
         perror("Can't get line number");
         return ERROR_READ;
     }
     if (bytes_read == 0) {
+        event_loop_remove(loop, fildes);
         return READ_NOTHING;
     }
     input[bytes_read] = '\0';
     return SUCCESS_READ;
 }
 
-int get_line_number(long long *line_num) {
+int get_line_number(event_loop *loop, long long *line_num) {
     char input[INPUT_SIZE + 1];
 
     int write_check = write_to_console("Five seconds to enter line number: ", 35, WITHOUT_NEW_LINE);
     if (write_check == ERROR_WRITE) {
         return ERROR_GET_LINE_NUMBER;
     }
+    int deadline_check = event_loop_set_deadline(loop, TIMEOUT_SEC);
+    if (deadline_check == EVENT_LOOP_ERROR) {
+        return ERROR_GET_LINE_NUMBER;
+    }
 
-    int read_check = read_from_console(input, INPUT_SIZE);
+    int read_check = read_from_console(loop, input, INPUT_SIZE);
     switch (read_check) {
         case ERROR_READ:
             return ERROR_GET_LINE_NUMBER;
         case READ_TIMEOUT:
             return GET_LINE_NUMBER_TIMEOUT;
+        case READ_INTERRUPTED:
+            return GET_LINE_NUMBER_INTERRUPTED;
         case READ_NOTHING:
             return INVALID_LINE_NUMBER_INPUT;
     }
 
     char *endptr = input;
+    errno = NO_ERROR;
     *line_num = strtoll(input, &endptr, DECIMAL_SYSTEM);
 
     int strtoll_check = validate_strtoll(endptr);
@@ -261,44 +346,55 @@ int get_line_number(long long *line_num) {
     return SUCCESS_GET_LINE_NUMBER;
 }
 
-int read_line(int fildes, off_t offset, size_t length, char *buf) {
-    off_t lseek_check = lseek(fildes, offset, SEEK_SET);
-    if (lseek_check == ERROR_LSEEK) {
-        perror("Can't get/set position in file");
-        return ERROR_READ;
+int fetch_source(int fildes, gzip_reader *gzip, off_t offset, size_t length, char *buf) {
+    if (gzip == NULL) {
+        return fetch_range(fildes, offset, length, buf);
     }
-
-    ssize_t bytes_read = read(fildes, buf, length);
-    if (bytes_read == ERROR_READ) {
-        perror("Can't read from file");
-        return ERROR_READ;
-    }
-
-    return SUCCESS_READ;
+    int read_check = gzip_reader_read(gzip, offset, length, buf);
+    return (read_check == GZIP_INDEX_ERROR) ? FETCH_ERROR : FETCH_SUCCESS;
 }
 
-int print_file(int fildes) {
-    off_t lseek_check = lseek(fildes, 0L, SEEK_SET);
-    if (lseek_check == ERROR_LSEEK) {
-        perror("Can't get/set position in file");
+int print_gzip_file(gzip_reader *gzip) {
+    char *buf = (char *) malloc(STREAM_BUFFER_SIZE);
+    if (buf == NULL) {
+        perror("Can't print file");
         return ERROR_PRINT_FILE;
     }
 
-    char buf[BUFFER_SIZE];
-    while (TRUE) {
-        ssize_t bytes_read = read(fildes, buf, BUFFER_SIZE);
-        if (bytes_read == ERROR_READ) {
-            perror("Can't read from file");
+    uint64_t offset = 0, size = gzip->index->size;
+    while (offset < size) {
+        size_t part = (size - offset < STREAM_BUFFER_SIZE) ? size - offset : STREAM_BUFFER_SIZE;
+        int fetch_check = fetch_source(NO_SPILL, gzip, offset, part, buf);
+        if (fetch_check == FETCH_ERROR || write_to_console(buf, part, WITHOUT_NEW_LINE) == ERROR_WRITE) {
+            free(buf);
             return ERROR_PRINT_FILE;
         }
-        if (bytes_read == READ_EOF) {
-            break;
-        }
+        offset += part;
+    }
+    free(buf);
 
-        int write_check = write_to_console(buf, bytes_read, WITHOUT_NEW_LINE);
-        if (write_check == ERROR_WRITE) {
-            return ERROR_PRINT_FILE;
-        }
+    int write_check = write_to_console("\n", 1, WITHOUT_NEW_LINE);
+    if (write_check == ERROR_WRITE) {
+        return ERROR_PRINT_FILE;
+    }
+    return SUCCESS_PRINT_FILE;
+}
+
+int print_file(int fildes, gzip_reader *gzip) {
+    if (gzip != NULL) {
+        return print_gzip_file(gzip);
+    }
+
+    struct stat file_stat;
+    int fstat_check = fstat(fildes, &file_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get file stat");
+        return ERROR_PRINT_FILE;
+    }
+
+    int dump_check = dump_file(fildes, FILE_START_POS, file_stat.st_size, STDOUT_FILENO);
+    if (dump_check == DUMP_ERROR) {
+        return ERROR_PRINT_FILE;
     }
 
     int write_check = write_to_console("\n", 1, WITHOUT_NEW_LINE);
@@ -309,9 +405,9 @@ int print_file(int fildes) {
     return SUCCESS_PRINT_FILE;
 }
 
-int open_file(int argc, char** argv, int *fildes) {
+int open_file(int argc, char** argv, int *fildes, struct stat *file_stat) {
     if (argc < 2) {
-        printf("Usage: %s <filename>\n", argv[0]);
+        printf("Usage: %s <filename> [line numbers file]\n", argv[0]);
         return ERROR_OPEN_FILE;
     }
     *fildes = open(argv[1], O_RDONLY);
@@ -319,6 +415,12 @@ int open_file(int argc, char** argv, int *fildes) {
         perror("Can't open file");
         return ERROR_OPEN_FILE;
     }
+
+    int fstat_check = fstat(*fildes, file_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get file stat");
+        return ERROR_OPEN_FILE;
+    }
     return SUCCESS_OPEN_FILE;
 }
 
@@ -331,40 +433,124 @@ int close_file(int fildes) {
     return SUCCESS_CLOSE_FILE;
 }
 
-int print_line(int fildes, line_info *table, long long line_num) {
+int print_line(int fildes, gzip_reader *gzip, line_info *table, long long line_num) {
     off_t line_offset = table[line_num - 1].offset;
     size_t line_length = table[line_num - 1].length;
-    char line[line_length];
+    size_t chunk_size = (line_length < LINE_CHUNK_SIZE) ? line_length : LINE_CHUNK_SIZE;
 
-    int read_check = read_line(fildes, line_offset, line_length, line);
-    if (read_check == ERROR_READ) {
+    char *chunk = (char *) malloc(chunk_size + 1);
+    if (chunk == NULL) {
+        perror("Can't print line");
         return ERROR_PRINT_LINE;
     }
 
-    int write_check = write_to_console(line, line_length, WITH_NEW_LINE);
-    if (write_check == ERROR_WRITE) {
-        return ERROR_PRINT_LINE;
-    }
+    do {
+        size_t part = (line_length < chunk_size) ? line_length : chunk_size;
+        int fetch_check = fetch_source(fildes, gzip, line_offset, part, chunk);
+        if (fetch_check == FETCH_ERROR) {
+            free(chunk);
+            return ERROR_PRINT_LINE;
+        }
+        line_offset += part;
+        line_length -= part;
+
+        int write_check = write_to_console(chunk, part, (line_length == 0) ? WITH_NEW_LINE : WITHOUT_NEW_LINE);
+        if (write_check == ERROR_WRITE) {
+            free(chunk);
+            return ERROR_PRINT_LINE;
+        }
+    } while (line_length > 0);
+
+    free(chunk);
     return SUCCESS_PRINT_LINE;
 }
 
-int print_lines(int fildes, line_info *table, long long table_length) {
+event_loop *open_input_loop(int *control_fildes) {
+    *control_fildes = NO_CONTROL;
+    event_loop *loop = event_loop_create();
+    if (loop == NULL) {
+        return NULL;
+    }
+
+    int add_check = event_loop_add(loop, STDIN_FILENO);
+    if (add_check == EVENT_LOOP_ERROR) {
+        event_loop_destroy(loop);
+        return NULL;
+    }
+
+    const char *control_name = getenv(CONTROL_ENV);
+    if (control_name != NULL) {
+        *control_fildes = open(control_name, O_RDWR);
+        if (*control_fildes == ERROR_OPEN_FILE) {
+            perror("Can't open control file");
+        } else if (event_loop_add(loop, *control_fildes) == EVENT_LOOP_ERROR) {
+            close_file(*control_fildes);
+            *control_fildes = NO_CONTROL;
+        }
+    }
+    return loop;
+}
+
+void close_input_loop(event_loop *loop, int control_fildes) {
+    if (control_fildes != NO_CONTROL) {
+        close_file(control_fildes);
+    }
+    event_loop_destroy(loop);
+}
+
+void prefetch_lines(int fildes, gzip_reader *gzip, line_info *table, long long table_length, line_prefetcher *prefetcher) {
+    int count = line_prefetcher_predict(prefetcher, table_length);
+    for (int i = 0; i < count; i++) {
+        line_info *line = &table[prefetcher->predicted[i] - 1];
+        size_t length = (line->length < PREFETCH_MAX_BYTES) ? line->length : PREFETCH_MAX_BYTES;
+
+        /* only starts readahead, the reads happen while the prompt waits */
+        if (gzip != NULL) {
+            gzip_reader_prefetch(gzip, line->offset, length);
+        } else {
+            posix_fadvise(fildes, line->offset, length, POSIX_FADV_WILLNEED);
+        }
+    }
+}
+
+void print_prefetch_info(const line_prefetcher *prefetcher) {
+    if (getenv(PREFETCH_STATS_ENV) == NULL || prefetcher->hits + prefetcher->misses == 0) {
+        return;
+    }
+    fprintf(stderr, "Prefetch: last pattern %s, %lld hits, %lld misses, %lld lines prefetched\n",
+            line_prefetcher_pattern(prefetcher), prefetcher->hits, prefetcher->misses, prefetcher->prefetched);
+}
+
+int print_lines(int fildes, gzip_reader *gzip, line_info *table, long long table_length) {
     if (table == NULL) {
         return ERROR_PRINT_LINES;
     }
 
+    int control_fildes;
+    event_loop *loop = open_input_loop(&control_fildes);
+    if (loop == NULL) {
+        return ERROR_PRINT_LINES;
+    }
+
+    line_prefetcher prefetcher;
+    line_prefetcher_init(&prefetcher);
+    int result = SUCCESS_PRINT_LINES;
     long long line_num;
     while (NOT_STOP_INPUT) {
-        int get_line_num_check = get_line_number(&line_num);
+        int get_line_num_check = get_line_number(loop, &line_num);
 
         if (get_line_num_check == ERROR_GET_LINE_NUMBER) {
-            return ERROR_PRINT_LINES;
+            result = ERROR_PRINT_LINES;
+            break;
+        }
+        if (get_line_num_check == GET_LINE_NUMBER_INTERRUPTED) {
+            break;
         }
         if (get_line_num_check == INVALID_LINE_NUMBER_INPUT) {
             continue;
         }
         if (get_line_num_check == GET_LINE_NUMBER_TIMEOUT) {
-            print_file(fildes);
+            print_file(fildes, gzip);
             break;
         }
         if (line_num < 0 || line_num > table_length) {
@@ -375,28 +561,288 @@ int print_lines(int fildes, line_info *table, long long table_length) {
             break;
         }
 
-        int print_line_check = print_line(fildes, table, line_num);
+        line_prefetcher_record(&prefetcher, line_num);
+        int print_line_check = print_line(fildes, gzip, table, line_num);
         if (print_line_check == ERROR_PRINT_LINE) {
-            return ERROR_PRINT_LINES;
+            result = ERROR_PRINT_LINES;
+            break;
+        }
+        prefetch_lines(fildes, gzip, table, table_length, &prefetcher);
+    }
+
+    close_input_loop(loop, control_fildes);
+    print_prefetch_info(&prefetcher);
+    return result;
+}
+
+int count_fetch_threads() {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count == ERROR_SYSCONF || cpu_count < SINGLE_THREAD) {
+        cpu_count = SINGLE_THREAD;
+    }
+    return (int) cpu_count;
+}
+
+char *read_line_file(const char *name, size_t *text_length) {
+    int fildes = open(name, O_RDONLY);
+    if (fildes == ERROR_OPEN_FILE) {
+        perror("Can't open line numbers file");
+        return NULL;
+    }
+
+    size_t text_size = INIT_TEXT_SIZE;
+    *text_length = 0;
+    char *text = (char *) malloc(text_size + 1);
+    while (text != NULL) {
+        if (*text_length == text_size) {
+            char *ptr = (char *) realloc(text, 2 * text_size + 1);
+            if (ptr == NULL) {
+                perror("Can't read line numbers file");
+                free(text);
+                text = NULL;
+                break;
+            }
+            text = ptr;
+            text_size *= 2;
+        }
+
+        ssize_t bytes_read = read(fildes, text + *text_length, text_size - *text_length);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read line numbers file");
+            free(text);
+            text = NULL;
+            break;
+        }
+        if (bytes_read == READ_EOF) {
+            text[*text_length] = '\0';
+            break;
         }
+        *text_length += bytes_read;
     }
-    return SUCCESS_PRINT_LINES;
+
+    close_file(fildes);
+    return text;
+}
+
+int print_fetched_lines(output_buffer *out, fetched_line *lines, long long count) {
+    for (long long i = 0; i < count; i++) {
+        if (lines[i].status == FETCH_ERROR) {
+            continue;
+        }
+        int output_check = output_reference(out, lines[i].data, lines[i].length);
+        if (output_check == OUTPUT_SUCCESS) {
+            output_check = output_append(out, "\n", 1);
+        }
+        if (output_check == OUTPUT_ERROR) {
+            perror("Can't write to console");
+            return ERROR_ANSWER_LINE_FILE;
+        }
+    }
+
+    int flush_check = output_flush(out);
+    if (flush_check == OUTPUT_ERROR) {
+        perror("Can't write to console");
+        return ERROR_ANSWER_LINE_FILE;
+    }
+    return SUCCESS_ANSWER_LINE_FILE;
+}
+
+int compare_line_requests(const void *first, const void *second) {
+    long long first_num = ((const line_request *) first)->line_num;
+    long long second_num = ((const line_request *) second)->line_num;
+    return (first_num > second_num) - (first_num < second_num);
+}
+
+void fetch_gzip_lines(gzip_reader *gzip, line_info *table, long long table_length,
+                      const long long *line_nums, long long count, fetched_line *lines) {
+    line_request *requests = (line_request *) malloc(count * sizeof(line_request));
+    for (long long i = 0; i < count; i++) {
+        lines[i].data = NULL;
+        lines[i].length = 0;
+        lines[i].status = FETCH_ERROR;
+        if (requests != NULL) {
+            requests[i].line_num = line_nums[i];
+            requests[i].position = i;
+        }
+    }
+    if (requests == NULL) {
+        perror("Can't fetch lines");
+        return;
+    }
+    qsort(requests, count, sizeof(line_request), compare_line_requests);
+
+    for (long long i = 0; i < count; i++) {
+        long long line_num = requests[i].line_num;
+        fetched_line *line = &lines[requests[i].position];
+        if (line_num < 1 || line_num > table_length) {
+            fprintf(stderr, "Invalid line number %lld. It has to be in range [1, %lld]\n", line_num, table_length);
+            continue;
+        }
+
+        const line_info *info = &table[line_num - 1];
+        line->data = (char *) malloc(info->length + 1);
+        if (line->data == NULL) {
+            perror("Can't fetch line");
+            continue;
+        }
+        int fetch_check = fetch_source(NO_SPILL, gzip, info->offset, info->length, line->data);
+        if (fetch_check == FETCH_ERROR) {
+            free(line->data);
+            line->data = NULL;
+            continue;
+        }
+        line->length = info->length;
+        line->status = FETCH_SUCCESS;
+    }
+    free(requests);
+}
+
+int answer_line_file(int fildes, gzip_reader *gzip, line_info *table, long long table_length, const char *name) {
+    size_t text_length;
+    char *text = read_line_file(name, &text_length);
+    if (text == NULL) {
+        return ERROR_ANSWER_LINE_FILE;
+    }
+
+    long long *line_nums = (long long *) malloc(FETCH_BATCH_SIZE * sizeof(long long));
+    fetched_line *lines = (fetched_line *) malloc(FETCH_BATCH_SIZE * sizeof(fetched_line));
+    output_buffer *out = (output_buffer *) malloc(sizeof(output_buffer));
+    line_fetcher *fetcher = NULL;
+    if (line_nums == NULL || lines == NULL || out == NULL) {
+        perror("Can't answer line numbers file");
+    } else if (gzip == NULL) {
+        fetcher = line_fetcher_create(fildes, table, table_length, count_fetch_threads());
+    }
+
+    int ready = (line_nums != NULL && lines != NULL && out != NULL && (gzip != NULL || fetcher != NULL));
+    int result = (ready) ? SUCCESS_ANSWER_LINE_FILE : ERROR_ANSWER_LINE_FILE;
+    char *c = text, *end = text + text_length;
+    if (ready) {
+        output_init(out, STDOUT_FILENO);
+    }
+    while (result == SUCCESS_ANSWER_LINE_FILE && c < end) {
+        long long count = 0;
+        while (count < FETCH_BATCH_SIZE && c < end) {
+            char *endptr = c;
+            errno = NO_ERROR;
+            long long line_num = strtoll(c, &endptr, DECIMAL_SYSTEM);
+            if (endptr == c) {
+                if (*c != '\0' && strchr(" \t\r\n", *c) == NULL) {
+                    fprintf(stderr, "Number contains invalid symbols\n");
+                }
+                c++;
+                continue;
+            }
+            c = endptr;
+            if (errno != NO_ERROR) {
+                perror("Can't convert given number");
+                continue;
+            }
+            line_nums[count++] = line_num;
+        }
+
+        if (gzip != NULL) {
+            fetch_gzip_lines(gzip, table, table_length, line_nums, count, lines);
+        } else {
+            line_fetcher_run(fetcher, line_nums, count, lines);
+        }
+        result = print_fetched_lines(out, lines, count);
+        release_lines(lines, count);
+    }
+
+    line_fetcher_destroy(fetcher);
+    free(out);
+    free(lines);
+    free(line_nums);
+    free(text);
+    return result;
+}
+
+int open_gzip(int fildes, const char *name, struct stat *file_stat, gzip_index **index, gzip_reader **gzip) {
+    *index = gzip_index_load(name, file_stat);
+    if (*index == NULL) {
+        *index = gzip_index_build(fildes, GZIP_DEFAULT_SPAN);
+        if (*index == NULL) {
+            return ERROR_OPEN_GZIP;
+        }
+        gzip_index_save(name, file_stat, *index);
+    }
+
+    *gzip = gzip_reader_create(*index, fildes);
+    if (*gzip == NULL) {
+        gzip_index_destroy(*index);
+        *index = NULL;
+        return ERROR_OPEN_GZIP;
+    }
+    return SUCCESS_OPEN_GZIP;
 }
 
 int main(int argc, char** argv) {
     int fildes;
-    int open_check = open_file(argc, argv, &fildes);
+    struct stat file_stat;
+    int open_check = open_file(argc, argv, &fildes, &file_stat);
     if (open_check == ERROR_OPEN_FILE) {
         return 0;
     }
 
+    int streamed = is_streamed(fildes, &file_stat);
+    gzip_index *gzip_lines = NULL;
+    gzip_reader *gzip = NULL;
+    if (!streamed && is_gzip_file(fildes)) {
+        int gzip_check = open_gzip(fildes, argv[1], &file_stat, &gzip_lines, &gzip);
+        if (gzip_check == ERROR_OPEN_GZIP) {
+            close_file(fildes);
+            return 0;
+        }
+    }
+
+    int spill_fildes = NO_SPILL;
+    if (streamed) {
+        int spill_check = create_spill_file(&spill_fildes);
+        if (spill_check == ERROR_SPILL) {
+            close_file(fildes);
+            return 0;
+        }
+    }
+
+    index_cache cache;
+    cache.addr = NULL;
     long long table_length = 0;
-    line_info *table = create_table(fildes, &table_length);
+    line_info *table = NULL;
+    if (gzip != NULL) {
+        table = gzip_lines->table;
+        table_length = gzip_lines->length;
+    } else if (spill_fildes == NO_SPILL) {
+        table = load_index_cache(argv[1], &file_stat, &table_length, &cache);
+    }
+    if (table == NULL) {
+        long long expected_length = (spill_fildes == NO_SPILL) ? estimate_line_count(fildes, file_stat.st_size) : TABLE_INIT_SIZE;
+        table = create_table(fildes, spill_fildes, expected_length, &table_length);
+        if (table != NULL && spill_fildes == NO_SPILL) {
+            save_index_cache(argv[1], &file_stat, table, table_length);
+        }
+    }
+    if (spill_fildes != NO_SPILL) {
+        close_file(fildes);
+        fildes = spill_fildes;
+    }
 
-    print_lines(fildes, table, table_length);
+    if (table != NULL && argc > LINE_FILE_ARG) {
+        answer_line_file(fildes, gzip, table, table_length, argv[LINE_FILE_ARG]);
+    } else {
+        print_lines(fildes, gzip, table, table_length);
+    }
 
-    if (table != NULL) {
-        free(table);
+    if (gzip != NULL) {
+        gzip_reader_destroy(gzip);
+        gzip_index_destroy(gzip_lines);
+    } else if (cache.addr != NULL) {
+        close_index_cache(&cache);
+    } else if (table != NULL) {
+        line_table_free(table);
     }
     close_file(fildes);
     return 0;
@@ -0,0 +1,447 @@
+#include "line_fetch.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_PREAD -1
+#define PREAD_EOF 0
+#define TRUE 1
+#define FALSE 0
+#define DEFAULT_ATTR NULL
+#define IGNORE_RESULT NULL
+#define SUCCESS_PTHREAD 0
+#define ERROR_RING -1
+#define READ_EOF 0
+#define ANY_ADDRESS 0
+#define MIN_COMPLETE 1
+#define RING_READ_MAX (1U << 30)
+
+int fetch_range(int fildes, off_t offset, size_t length, char *buf) {
+    while (length > 0) {
+        ssize_t bytes_read = pread(fildes, buf, length, offset);
+        if (bytes_read == ERROR_PREAD) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read from file");
+            return FETCH_ERROR;
+        }
+        if (bytes_read == PREAD_EOF) {
+            fprintf(stderr, "Can't read from file: Unexpected end of file\n");
+            return FETCH_ERROR;
+        }
+        buf += bytes_read;
+        offset += bytes_read;
+        length -= bytes_read;
+    }
+    return FETCH_SUCCESS;
+}
+
+int fetch_line(int fildes, const line_info *table, long long table_length, long long line_num, fetched_line *line) {
+    line->data = NULL;
+    line->length = 0;
+    line->status = FETCH_ERROR;
+    if (line_num < 1 || line_num > table_length) {
+        fprintf(stderr, "Invalid line number %lld. It has to be in range [1, %lld]\n", line_num, table_length);
+        return FETCH_ERROR;
+    }
+
+    const line_info *info = &table[line_num - 1];
+    line->data = (char *) malloc(info->length + 1);
+    if (line->data == NULL) {
+        perror("Can't fetch line");
+        return FETCH_ERROR;
+    }
+
+    int fetch_check = fetch_range(fildes, info->offset, info->length, line->data);
+    if (fetch_check == FETCH_ERROR) {
+        free(line->data);
+        line->data = NULL;
+        return FETCH_ERROR;
+    }
+    line->length = info->length;
+    line->status = FETCH_SUCCESS;
+    return FETCH_SUCCESS;
+}
+
+void release_lines(fetched_line *lines, long long count) {
+    for (long long i = 0; i < count; i++) {
+        free(lines[i].data);
+        lines[i].data = NULL;
+    }
+}
+
+static void *fetch_worker(void *arg) {
+    fetch_pool *pool = (fetch_pool *) arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (TRUE) {
+        while (pool->stop == FALSE && pool->next >= pool->count) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->stop == TRUE) {
+            break;
+        }
+
+        long long begin = pool->next;
+        long long end = begin + FETCH_GRAIN;
+        if (end > pool->count) {
+            end = pool->count;
+        }
+        pool->next = end;
+        pthread_mutex_unlock(&pool->lock);
+
+        for (long long i = begin; i < end; i++) {
+            fetch_line(pool->fildes, pool->table, pool->table_length, pool->line_nums[i], &pool->lines[i]);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->done += end - begin;
+        if (pool->done == pool->count) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+fetch_pool *fetch_pool_create(int fildes, const line_info *table, long long table_length, int thread_count) {
+    if (table == NULL || thread_count < 1) {
+        fprintf(stderr, "Can't create fetch pool: Invalid argument(s)\n");
+        return NULL;
+    }
+
+    fetch_pool *pool = (fetch_pool *) calloc(1, sizeof(fetch_pool));
+    if (pool == NULL) {
+        perror("Can't create fetch pool");
+        return NULL;
+    }
+    pool->threads = (pthread_t *) malloc(thread_count * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        perror("Can't create fetch pool");
+        free(pool);
+        return NULL;
+    }
+
+    pool->fildes = fildes;
+    pool->table = table;
+    pool->table_length = table_length;
+    pthread_mutex_init(&pool->lock, DEFAULT_ATTR);
+    pthread_cond_init(&pool->work_ready, DEFAULT_ATTR);
+    pthread_cond_init(&pool->work_done, DEFAULT_ATTR);
+
+    for (int i = 0; i < thread_count; i++) {
+        int create_check = pthread_create(&pool->threads[i], DEFAULT_ATTR, fetch_worker, pool);
+        if (create_check != SUCCESS_PTHREAD) {
+            fprintf(stderr, "Can't start fetch thread\n");
+            break;
+        }
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        fetch_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int fetch_pool_run(fetch_pool *pool, const long long *line_nums, long long count, fetched_line *lines) {
+    if (pool == NULL || line_nums == NULL || lines == NULL || count < 0) {
+        fprintf(stderr, "Can't fetch lines: Invalid argument(s)\n");
+        return FETCH_ERROR;
+    }
+    if (count == 0) {
+        return FETCH_SUCCESS;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->line_nums = line_nums;
+    pool->lines = lines;
+    pool->next = 0;
+    pool->done = 0;
+    pool->count = count;
+    pthread_cond_broadcast(&pool->work_ready);
+    while (pool->done < pool->count) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pool->count = 0;
+    pool->next = 0;
+    pthread_mutex_unlock(&pool->lock);
+    return FETCH_SUCCESS;
+}
+
+void fetch_pool_destroy(fetch_pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], IGNORE_RESULT);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool);
+}
+
+static int ring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ring_enter(int ring_fildes, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, ring_fildes, to_submit, min_complete, flags, NULL, 0);
+}
+
+fetch_ring *fetch_ring_create(unsigned entries) {
+    fetch_ring *ring = (fetch_ring *) calloc(1, sizeof(fetch_ring));
+    if (ring == NULL) {
+        perror("Can't create fetch ring");
+        return NULL;
+    }
+    ring->sq_ring = MAP_FAILED;
+    ring->cq_ring = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->ring_fildes = ring_setup(entries, &params);
+    if (ring->ring_fildes == ERROR_RING) {
+        free(ring);
+        return NULL;
+    }
+    ring->entries = params.sq_entries;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(ANY_ADDRESS, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->ring_fildes, IORING_OFF_SQ_RING);
+    if (ring->sq_ring != MAP_FAILED && (params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_ring = ring->sq_ring;
+    } else if (ring->sq_ring != MAP_FAILED) {
+        ring->cq_ring = mmap(ANY_ADDRESS, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring->ring_fildes, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) mmap(ANY_ADDRESS, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                              ring->ring_fildes, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        perror("Can't map fetch ring");
+        fetch_ring_destroy(ring);
+        return NULL;
+    }
+
+    char *sq = (char *) ring->sq_ring;
+    char *cq = (char *) ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return ring;
+}
+
+static void queue_read(fetch_ring *ring, int fildes, char *buf, size_t length, off_t offset, long long position) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fildes;
+    sqe->addr = (unsigned long) buf;
+    sqe->len = (length > RING_READ_MAX) ? RING_READ_MAX : length;
+    sqe->off = offset;
+    sqe->user_data = position;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void fail_line(fetched_line *line) {
+    free(line->data);
+    line->data = NULL;
+    line->status = FETCH_ERROR;
+}
+
+int fetch_ring_run(fetch_ring *ring, int fildes, const line_info *table, long long table_length,
+                   const long long *line_nums, long long count, fetched_line *lines) {
+    if (ring == NULL || table == NULL || line_nums == NULL || lines == NULL || count < 0) {
+        fprintf(stderr, "Can't fetch lines: Invalid argument(s)\n");
+        return FETCH_ERROR;
+    }
+
+    long long next = 0, completed = 0;
+    unsigned in_flight = 0, to_submit = 0;
+    while (completed < count) {
+        while (next < count && in_flight < ring->entries) {
+            fetched_line *line = &lines[next];
+            long long line_num = line_nums[next];
+            line->data = NULL;
+            line->length = 0;
+            line->status = FETCH_ERROR;
+            if (line_num < 1 || line_num > table_length) {
+                fprintf(stderr, "Invalid line number %lld. It has to be in range [1, %lld]\n", line_num, table_length);
+                completed++;
+                next++;
+                continue;
+            }
+
+            const line_info *info = &table[line_num - 1];
+            line->data = (char *) malloc(info->length + 1);
+            if (line->data == NULL) {
+                perror("Can't fetch line");
+                completed++;
+                next++;
+                continue;
+            }
+            if (info->length == 0) {
+                line->status = FETCH_SUCCESS;
+                completed++;
+                next++;
+                continue;
+            }
+
+            queue_read(ring, fildes, line->data, info->length, info->offset, next);
+            in_flight++;
+            to_submit++;
+            next++;
+        }
+        if (in_flight == 0) {
+            continue;
+        }
+
+        int enter_check = ring_enter(ring->ring_fildes, to_submit, MIN_COMPLETE, IORING_ENTER_GETEVENTS);
+        if (enter_check == ERROR_RING) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            perror("Can't submit reads");
+            return FETCH_ERROR;
+        }
+        to_submit -= enter_check;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            long long position = (long long) cqe->user_data;
+            int result = cqe->res;
+            fetched_line *line = &lines[position];
+            const line_info *info = &table[line_nums[position] - 1];
+
+            if (result == -EINTR || result == -EAGAIN) {
+                result = 0;
+            } else if (result == -EINVAL || result == -EOPNOTSUPP) {
+                free(line->data);
+                fetch_line(fildes, table, table_length, line_nums[position], line);
+                in_flight--;
+                completed++;
+                continue;
+            } else if (result < 0) {
+                errno = -result;
+                perror("Can't read from file");
+                fail_line(line);
+                in_flight--;
+                completed++;
+                continue;
+            } else if (result == READ_EOF) {
+                fprintf(stderr, "Can't read from file: Unexpected end of file\n");
+                fail_line(line);
+                in_flight--;
+                completed++;
+                continue;
+            }
+
+            line->length += result;
+            if (line->length < info->length) {
+                queue_read(ring, fildes, line->data + line->length, info->length - line->length,
+                           info->offset + line->length, position);
+                to_submit++;
+                continue;
+            }
+            line->status = FETCH_SUCCESS;
+            in_flight--;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return FETCH_SUCCESS;
+}
+
+void fetch_ring_destroy(fetch_ring *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    if (ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->ring_fildes);
+    free(ring);
+}
+
+line_fetcher *line_fetcher_create(int fildes, const line_info *table, long long table_length, int thread_count) {
+    line_fetcher *fetcher = (line_fetcher *) calloc(1, sizeof(line_fetcher));
+    if (fetcher == NULL) {
+        perror("Can't create line fetcher");
+        return NULL;
+    }
+    fetcher->fildes = fildes;
+    fetcher->table = table;
+    fetcher->table_length = table_length;
+
+    fetcher->ring = fetch_ring_create(FETCH_RING_ENTRIES);
+    if (fetcher->ring == NULL) {
+        fetcher->pool = fetch_pool_create(fildes, table, table_length, thread_count);
+        if (fetcher->pool == NULL) {
+            free(fetcher);
+            return NULL;
+        }
+    }
+    return fetcher;
+}
+
+const char *line_fetcher_backend(const line_fetcher *fetcher) {
+    return (fetcher->ring != NULL) ? "io_uring" : "thread pool";
+}
+
+int line_fetcher_run(line_fetcher *fetcher, const long long *line_nums, long long count, fetched_line *lines) {
+    if (fetcher->ring != NULL) {
+        return fetch_ring_run(fetcher->ring, fetcher->fildes, fetcher->table, fetcher->table_length, line_nums, count, lines);
+    }
+    return fetch_pool_run(fetcher->pool, line_nums, count, lines);
+}
+
+void line_fetcher_destroy(line_fetcher *fetcher) {
+    if (fetcher == NULL) {
+        return;
+    }
+    fetch_ring_destroy(fetcher->ring);
+    fetch_pool_destroy(fetcher->pool);
+    free(fetcher);
+}
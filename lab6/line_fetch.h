@@ -0,0 +1,84 @@
+#ifndef LAB6_LINE_FETCH_H
+#define LAB6_LINE_FETCH_H
+
+#include <sys/types.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stddef.h>
+#include "line_info.h"
+
+#define FETCH_ERROR -1
+#define FETCH_SUCCESS 0
+
+#define FETCH_GRAIN 64
+#define FETCH_RING_ENTRIES 256
+
+typedef struct fetched_line {
+    char *data;
+    size_t length;
+    int status;
+} fetched_line;
+
+typedef struct fetch_pool {
+    int fildes;
+    const line_info *table;
+    long long table_length;
+    pthread_t *threads;
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    const long long *line_nums;
+    fetched_line *lines;
+    long long count;
+    long long next;
+    long long done;
+    int stop;
+} fetch_pool;
+
+typedef struct fetch_ring {
+    int ring_fildes;
+    unsigned entries;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+} fetch_ring;
+
+typedef struct line_fetcher {
+    int fildes;
+    const line_info *table;
+    long long table_length;
+    fetch_ring *ring;
+    fetch_pool *pool;
+} line_fetcher;
+
+int fetch_range(int fildes, off_t offset, size_t length, char *buf);
+int fetch_line(int fildes, const line_info *table, long long table_length, long long line_num, fetched_line *line);
+void release_lines(fetched_line *lines, long long count);
+
+fetch_pool *fetch_pool_create(int fildes, const line_info *table, long long table_length, int thread_count);
+int fetch_pool_run(fetch_pool *pool, const long long *line_nums, long long count, fetched_line *lines);
+void fetch_pool_destroy(fetch_pool *pool);
+
+fetch_ring *fetch_ring_create(unsigned entries);
+int fetch_ring_run(fetch_ring *ring, int fildes, const line_info *table, long long table_length,
+                   const long long *line_nums, long long count, fetched_line *lines);
+void fetch_ring_destroy(fetch_ring *ring);
+
+line_fetcher *line_fetcher_create(int fildes, const line_info *table, long long table_length, int thread_count);
+const char *line_fetcher_backend(const line_fetcher *fetcher);
+int line_fetcher_run(line_fetcher *fetcher, const long long *line_nums, long long count, fetched_line *lines);
+void line_fetcher_destroy(line_fetcher *fetcher);
+
+#endif
@@ -0,0 +1,102 @@
+#include "line_prefetch.h"
+#include <string.h>
+
+#define TRUE 1
+#define FALSE 0
+
+static void add_prediction(line_prefetcher *prefetcher, long long line_num, long long max_line) {
+    if (line_num >= 1 && line_num <= max_line && prefetcher->predicted_length < PREFETCH_MAX_LINES) {
+        prefetcher->predicted[prefetcher->predicted_length++] = line_num;
+    }
+}
+
+static void predict_steps(line_prefetcher *prefetcher, long long last, long long step, long long max_line) {
+    for (long long i = 1; i <= PREFETCH_DEPTH; i++) {
+        add_prediction(prefetcher, last + i * step, max_line);
+    }
+}
+
+void line_prefetcher_init(line_prefetcher *prefetcher) {
+    memset(prefetcher, 0, sizeof(line_prefetcher));
+    prefetcher->pattern = PATTERN_NONE;
+}
+
+void line_prefetcher_record(line_prefetcher *prefetcher, long long line_num) {
+    if (prefetcher->predicted_length > 0) {
+        int hit = FALSE;
+        for (int i = 0; i < prefetcher->predicted_length && hit == FALSE; i++) {
+            hit = (prefetcher->predicted[i] == line_num);
+        }
+        if (hit == TRUE) {
+            prefetcher->hits++;
+        } else {
+            prefetcher->misses++;
+        }
+    }
+
+    if (prefetcher->history_length == PREFETCH_HISTORY) {
+        memmove(prefetcher->history, prefetcher->history + 1, (PREFETCH_HISTORY - 1) * sizeof(long long));
+        prefetcher->history_length--;
+    }
+    prefetcher->history[prefetcher->history_length++] = line_num;
+}
+
+int line_prefetcher_predict(line_prefetcher *prefetcher, long long max_line) {
+    prefetcher->predicted_length = 0;
+    prefetcher->pattern = PATTERN_NONE;
+    int length = prefetcher->history_length;
+    if (length == 0) {
+        return 0;
+    }
+
+    const long long *history = prefetcher->history;
+    long long last = history[length - 1];
+    long long step = (length >= 2) ? last - history[length - 2] : 0;
+    long long previous_step = (length >= 3) ? history[length - 2] - history[length - 3] : 0;
+
+    long long low = last, high = last;
+    for (int i = 0; i < length; i++) {
+        low = (history[i] < low) ? history[i] : low;
+        high = (history[i] > high) ? history[i] : high;
+    }
+
+    if (step == 1 || step == -1) {
+        prefetcher->pattern = PATTERN_SEQUENTIAL;
+        predict_steps(prefetcher, last, step, max_line);
+    } else if (step != 0 && step == previous_step) {
+        prefetcher->pattern = PATTERN_STRIDED;
+        predict_steps(prefetcher, last, step, max_line);
+    } else if (length >= 2 && high - low < PREFETCH_MAX_LINES) {
+        /* jumping around inside one screenful: cover the whole region */
+        prefetcher->pattern = PATTERN_REGION;
+        long long first = low - (PREFETCH_MAX_LINES - (high - low + 1)) / 2;
+        first = (first < 1) ? 1 : first;
+        for (long long line_num = first; line_num < first + PREFETCH_MAX_LINES; line_num++) {
+            add_prediction(prefetcher, line_num, max_line);
+        }
+    } else {
+        prefetcher->pattern = PATTERN_NEIGHBOURS;
+        for (long long i = 1; i <= PREFETCH_DEPTH / 2; i++) {
+            add_prediction(prefetcher, last + i, max_line);
+            add_prediction(prefetcher, last - i, max_line);
+        }
+    }
+
+    prefetcher->prefetched += prefetcher->predicted_length;
+    return prefetcher->predicted_length;
+}
+
+const char *line_prefetcher_pattern(const line_prefetcher *prefetcher) {
+    switch (prefetcher->pattern) {
+        case PATTERN_SEQUENTIAL:
+            return "sequential";
+        case PATTERN_STRIDED:
+            return "strided";
+        case PATTERN_REGION:
+            return "region";
+        case PATTERN_NEIGHBOURS:
+            return "neighbours";
+        default:
+            return "none";
+    }
+}
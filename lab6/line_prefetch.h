@@ -0,0 +1,39 @@
+#ifndef LAB6_LINE_PREFETCH_H
+#define LAB6_LINE_PREFETCH_H
+
+#define PREFETCH_HISTORY 4
+#define PREFETCH_DEPTH 8
+#define PREFETCH_MAX_LINES (2 * PREFETCH_DEPTH)
+#define PREFETCH_MAX_BYTES (1024 * 1024)
+
+typedef enum prefetch_pattern {
+    PATTERN_NONE,
+    PATTERN_SEQUENTIAL,
+    PATTERN_STRIDED,
+    PATTERN_REGION,
+    PATTERN_NEIGHBOURS
+} prefetch_pattern;
+
+/*
+ * Guesses which lines the viewer will ask for next from the last few
+ * requests, so they can be read ahead while the prompt waits for input.
+ * A request counts as a hit when it was among the lines predicted after
+ * the previous one.
+ */
+typedef struct line_prefetcher {
+    long long history[PREFETCH_HISTORY];
+    int history_length;
+    long long predicted[PREFETCH_MAX_LINES];
+    int predicted_length;
+    prefetch_pattern pattern;
+    long long hits;
+    long long misses;
+    long long prefetched;
+} line_prefetcher;
+
+void line_prefetcher_init(line_prefetcher *prefetcher);
+void line_prefetcher_record(line_prefetcher *prefetcher, long long line_num);
+int line_prefetcher_predict(line_prefetcher *prefetcher, long long max_line);
+const char *line_prefetcher_pattern(const line_prefetcher *prefetcher);
+
+#endif
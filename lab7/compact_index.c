@@ -0,0 +1,279 @@
+#include "compact_index.h"
+#include "newline_scan.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INIT_BLOCK_CAPACITY 16
+#define INIT_BITS_CAPACITY 64
+#define WORD_BITS 64
+#define SCAN_BATCH_SIZE 4096
+
+static int grow_blocks(compact_index *index) {
+    if (index->block_count < index->block_capacity) {
+        return COMPACT_INDEX_SUCCESS;
+    }
+
+    long long capacity = index->block_capacity * 2;
+    uint64_t *first_offsets = (uint64_t *) realloc(index->first_offsets, capacity * sizeof(uint64_t));
+    if (first_offsets == NULL) {
+        perror("Can't grow compact index");
+        return COMPACT_INDEX_ERROR;
+    }
+    index->first_offsets = first_offsets;
+
+    uint64_t *bit_positions = (uint64_t *) realloc(index->bit_positions, capacity * sizeof(uint64_t));
+    if (bit_positions == NULL) {
+        perror("Can't grow compact index");
+        return COMPACT_INDEX_ERROR;
+    }
+    index->bit_positions = bit_positions;
+
+    uint8_t *widths = (uint8_t *) realloc(index->widths, capacity * sizeof(uint8_t));
+    if (widths == NULL) {
+        perror("Can't grow compact index");
+        return COMPACT_INDEX_ERROR;
+    }
+    index->widths = widths;
+
+    index->block_capacity = capacity;
+    return COMPACT_INDEX_SUCCESS;
+}
+
+static int grow_bits(compact_index *index, size_t required_bits) {
+    size_t required = required_bits / WORD_BITS + 2;
+    if (required <= index->bits_capacity) {
+        return COMPACT_INDEX_SUCCESS;
+    }
+
+    size_t capacity = index->bits_capacity;
+    while (capacity < required) {
+        capacity *= 2;
+    }
+    uint64_t *bits = (uint64_t *) realloc(index->bits, capacity * sizeof(uint64_t));
+    if (bits == NULL) {
+        perror("Can't grow compact index");
+        return COMPACT_INDEX_ERROR;
+    }
+    memset(bits + index->bits_capacity, 0, (capacity - index->bits_capacity) * sizeof(uint64_t));
+    index->bits = bits;
+    index->bits_capacity = capacity;
+    return COMPACT_INDEX_SUCCESS;
+}
+
+static int bit_width(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    return WORD_BITS - __builtin_clzll(value);
+}
+
+static void write_bits(uint64_t *bits, size_t position, int width, uint64_t value) {
+    if (width == 0) {
+        return;
+    }
+    size_t word = position / WORD_BITS;
+    int shift = position % WORD_BITS;
+
+    bits[word] |= value << shift;
+    if (shift + width > WORD_BITS) {
+        bits[word + 1] |= value >> (WORD_BITS - shift);
+    }
+}
+
+static uint64_t read_bits(const uint64_t *bits, size_t position, int width) {
+    if (width == 0) {
+        return 0;
+    }
+    size_t word = position / WORD_BITS;
+    int shift = position % WORD_BITS;
+
+    uint64_t value = bits[word] >> shift;
+    if (shift + width > WORD_BITS) {
+        value |= bits[word + 1] << (WORD_BITS - shift);
+    }
+    if (width < WORD_BITS) {
+        value &= (1ULL << width) - 1;
+    }
+    return value;
+}
+
+static int flush_block(compact_index *index) {
+    if (index->pending_length == 0) {
+        return COMPACT_INDEX_SUCCESS;
+    }
+
+    int grow_check = grow_blocks(index);
+    if (grow_check == COMPACT_INDEX_ERROR) {
+        return COMPACT_INDEX_ERROR;
+    }
+
+    int width = 0;
+    for (int i = 1; i < index->pending_length; i++) {
+        int delta_width = bit_width(index->pending[i] - index->pending[i - 1]);
+        if (delta_width > width) {
+            width = delta_width;
+        }
+    }
+
+    grow_check = grow_bits(index, index->bits_length + (size_t) width * index->pending_length);
+    if (grow_check == COMPACT_INDEX_ERROR) {
+        return COMPACT_INDEX_ERROR;
+    }
+
+    long long block = index->block_count;
+    index->first_offsets[block] = index->pending[0];
+    index->bit_positions[block] = index->bits_length;
+    index->widths[block] = width;
+    for (int i = 1; i < index->pending_length; i++) {
+        write_bits(index->bits, index->bits_length, width, index->pending[i] - index->pending[i - 1]);
+        index->bits_length += width;
+    }
+
+    index->block_count++;
+    index->pending_length = 0;
+    return COMPACT_INDEX_SUCCESS;
+}
+
+compact_index *compact_index_create() {
+    compact_index *index = (compact_index *) calloc(1, sizeof(compact_index));
+    if (index == NULL) {
+        perror("Can't create compact index");
+        return NULL;
+    }
+
+    index->block_capacity = INIT_BLOCK_CAPACITY;
+    index->bits_capacity = INIT_BITS_CAPACITY;
+    index->first_offsets = (uint64_t *) malloc(index->block_capacity * sizeof(uint64_t));
+    index->bit_positions = (uint64_t *) malloc(index->block_capacity * sizeof(uint64_t));
+    index->widths = (uint8_t *) malloc(index->block_capacity * sizeof(uint8_t));
+    index->bits = (uint64_t *) calloc(index->bits_capacity, sizeof(uint64_t));
+    if (index->first_offsets == NULL || index->bit_positions == NULL || index->widths == NULL || index->bits == NULL) {
+        perror("Can't create compact index");
+        compact_index_destroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+int compact_index_add(compact_index *index, off_t line_offset) {
+    if (index == NULL) {
+        fprintf(stderr, "Can't add line to compact index: Invalid argument\n");
+        return COMPACT_INDEX_ERROR;
+    }
+
+    index->pending[index->pending_length++] = line_offset;
+    index->length++;
+    if (index->pending_length == COMPACT_BLOCK_LINES) {
+        return flush_block(index);
+    }
+    return COMPACT_INDEX_SUCCESS;
+}
+
+int compact_index_finish(compact_index *index, off_t file_size) {
+    if (index == NULL) {
+        fprintf(stderr, "Can't finish compact index: Invalid argument\n");
+        return COMPACT_INDEX_ERROR;
+    }
+
+    int flush_check = flush_block(index);
+    if (flush_check == COMPACT_INDEX_ERROR) {
+        return COMPACT_INDEX_ERROR;
+    }
+    index->file_size = file_size;
+
+    if (index->block_count > 0 && index->block_count < index->block_capacity) {
+        uint64_t *first_offsets = (uint64_t *) realloc(index->first_offsets, index->block_count * sizeof(uint64_t));
+        uint64_t *bit_positions = (uint64_t *) realloc(index->bit_positions, index->block_count * sizeof(uint64_t));
+        uint8_t *widths = (uint8_t *) realloc(index->widths, index->block_count * sizeof(uint8_t));
+        if (first_offsets != NULL) {
+            index->first_offsets = first_offsets;
+        }
+        if (bit_positions != NULL) {
+            index->bit_positions = bit_positions;
+        }
+        if (widths != NULL) {
+            index->widths = widths;
+        }
+        index->block_capacity = index->block_count;
+    }
+
+    size_t bits_required = index->bits_length / WORD_BITS + 2;
+    if (bits_required < index->bits_capacity) {
+        uint64_t *bits = (uint64_t *) realloc(index->bits, bits_required * sizeof(uint64_t));
+        if (bits != NULL) {
+            index->bits = bits;
+            index->bits_capacity = bits_required;
+        }
+    }
+
+    return COMPACT_INDEX_SUCCESS;
+}
+
+int compact_index_scan(compact_index *index, const char *addr, off_t offset, size_t size) {
+    off_t new_lines[SCAN_BATCH_SIZE];
+    size_t position = 0;
+    int add_check = COMPACT_INDEX_SUCCESS;
+
+    while (add_check == COMPACT_INDEX_SUCCESS && position < size) {
+        size_t scanned = 0;
+        size_t found = scan_newlines(addr + position, size - position, new_lines, SCAN_BATCH_SIZE, &scanned);
+        for (size_t i = 0; i < found && add_check == COMPACT_INDEX_SUCCESS; i++) {
+            add_check = compact_index_add(index, offset + position + new_lines[i] + 1);
+        }
+        position += scanned;
+    }
+    return add_check;
+}
+
+int compact_index_get(const compact_index *index, long long position, line_info *line) {
+    if (index == NULL || line == NULL || position < 0 || position >= index->length) {
+        fprintf(stderr, "Can't get line from compact index: Invalid argument(s)\n");
+        return COMPACT_INDEX_ERROR;
+    }
+
+    long long block = position / COMPACT_BLOCK_LINES;
+    int rest = position % COMPACT_BLOCK_LINES;
+    int width = index->widths[block];
+    size_t bit_position = index->bit_positions[block];
+
+    uint64_t line_offset = index->first_offsets[block];
+    for (int i = 0; i < rest; i++) {
+        line_offset += read_bits(index->bits, bit_position, width);
+        bit_position += width;
+    }
+
+    uint64_t next_offset;
+    if (position + 1 == index->length) {
+        next_offset = index->file_size + 1;
+    } else if (rest + 1 < COMPACT_BLOCK_LINES) {
+        next_offset = line_offset + read_bits(index->bits, bit_position, width);
+    } else {
+        next_offset = index->first_offsets[block + 1];
+    }
+
+    line->offset = line_offset;
+    line->length = next_offset - line_offset - 1;
+    return COMPACT_INDEX_SUCCESS;
+}
+
+size_t compact_index_bytes(const compact_index *index) {
+    if (index == NULL) {
+        return 0;
+    }
+    return sizeof(compact_index)
+        + index->block_capacity * (2 * sizeof(uint64_t) + sizeof(uint8_t))
+        + index->bits_capacity * sizeof(uint64_t);
+}
+
+void compact_index_destroy(compact_index *index) {
+    if (index == NULL) {
+        return;
+    }
+    free(index->first_offsets);
+    free(index->bit_positions);
+    free(index->widths);
+    free(index->bits);
+    free(index);
+}
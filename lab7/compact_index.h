@@ -0,0 +1,36 @@
+#ifndef LAB7_COMPACT_INDEX_H
+#define LAB7_COMPACT_INDEX_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include "line_info.h"
+
+#define COMPACT_INDEX_ERROR -1
+#define COMPACT_INDEX_SUCCESS 0
+
+#define COMPACT_BLOCK_LINES 64
+
+typedef struct compact_index {
+    long long length;
+    long long block_count;
+    long long block_capacity;
+    off_t file_size;
+    uint64_t *first_offsets;
+    uint64_t *bit_positions;
+    uint8_t *widths;
+    uint64_t *bits;
+    size_t bits_capacity;
+    size_t bits_length;
+    uint64_t pending[COMPACT_BLOCK_LINES];
+    int pending_length;
+} compact_index;
+
+compact_index *compact_index_create();
+int compact_index_add(compact_index *index, off_t line_offset);
+int compact_index_finish(compact_index *index, off_t file_size);
+int compact_index_scan(compact_index *index, const char *addr, off_t offset, size_t size);
+int compact_index_get(const compact_index *index, long long position, line_info *line);
+size_t compact_index_bytes(const compact_index *index);
+void compact_index_destroy(compact_index *index);
+
+#endif
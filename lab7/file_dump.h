@@ -0,0 +1,13 @@
+#ifndef LAB7_FILE_DUMP_H
+#define LAB7_FILE_DUMP_H
+
+#include <sys/types.h>
+
+#define DUMP_ERROR -1
+#define DUMP_SUCCESS 0
+
+#define DUMP_BUFFER_SIZE (1024 * 1024)
+
+int dump_file(int in_fildes, off_t offset, off_t length, int out_fildes);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef LAB7_INDEX_CACHE_H
+#define LAB7_INDEX_CACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "line_info.h"
+
+#define INDEX_CACHE_ERROR -1
+#define INDEX_CACHE_SUCCESS 0
+
+#define INDEX_CACHE_MAGIC "LINEIDX"
+#define INDEX_CACHE_MAGIC_SIZE 8
+#define INDEX_CACHE_VERSION 1
+#define INDEX_CACHE_SUFFIX ".idx"
+
+/*
+ * Sidecar "<file>.idx<entry size>" (".idx16" for line_info tables, ".idx4"
+ * and ".idx8" for offset tables), so indexes of different layouts never
+ * replace each other. The cache counts as current while the device,
+ * inode, size and mtime recorded here match the file; the checksum only
+ * covers the stored table, not the file contents, so an edit that keeps
+ * the size and mtime goes unnoticed.
+ */
+typedef struct index_cache_header {
+    char magic[INDEX_CACHE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t file_device;
+    uint64_t file_inode;
+    uint64_t file_size;
+    int64_t file_mtime_sec;
+    int64_t file_mtime_nsec;
+    uint64_t table_length;
+    uint64_t checksum;
+} index_cache_header;
+
+typedef struct index_cache {
+    void *addr;
+    size_t size;
+} index_cache;
+
+void *load_index_cache(const char *file_name, const struct stat *file_stat, size_t entry_size, long long *table_length, index_cache *cache);
+int save_index_cache(const char *file_name, const struct stat *file_stat, const void *table, size_t entry_size, long long table_length);
+int close_index_cache(index_cache *cache);
+
+#endif
@@ -1,13 +1,32 @@
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/inotify.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include "line_info.h"
+#include "newline_scan.h"
+#include "index_cache.h"
+#include "compact_index.h"
+#include "line_query.h"
+#include "console_output.h"
+#include "file_dump.h"
+#include "map_policy.h"
+#include "text_search.h"
+#include "utf8_index.h"
+#include "map_window.h"
+#include "line_table.h"
+#include "offset_index.h"
+#include "line_prefetch.h"
 
 extern int errno;
 
@@ -24,9 +43,24 @@ extern int errno;
 #define ERROR_PRINT_LINE -1
 #define ERROR_SELECT -1
 #define ERROR_FSTAT -1
+#define ERROR_FTRUNCATE -1
 #define ERROR_MUNMAP -1
 #define ERROR_STRTOLL -1
 #define ERROR_FILL_TABLE -1
+#define ERROR_SYSCONF -1
+#define ERROR_OPEN_INDEX -1
+#define ERROR_PARSE_OPTIONS -1
+#define ERROR_GET_LINE_INFO -1
+#define ERROR_EXTEND_INDEX -1
+#define ERROR_MAP_FILE -1
+#define ERROR_FOLLOW_FILE -1
+#define ERROR_INOTIFY -1
+#define ERROR_STAT -1
+#define ERROR_ANSWER_QUERIES -1
+#define ERROR_SPILL -1
+#define ERROR_SEARCH_FILE -1
+#define ERROR_OPEN_SET -1
+#define ERROR_EXPORT -1
 
 #define NO_ERROR 0
 #define SUCCESS_OPEN_FILE 0
@@ -41,6 +75,17 @@ extern int errno;
 #define SUCCESS_SELECT 1
 #define SUCCESS_STRTOLL 0
 #define SUCCESS_FILL_TABLE 0
+#define SUCCESS_OPEN_INDEX 0
+#define SUCCESS_PARSE_OPTIONS 0
+#define SUCCESS_GET_LINE_INFO 0
+#define SUCCESS_EXTEND_INDEX 0
+#define SUCCESS_MAP_FILE 0
+#define SUCCESS_FOLLOW_FILE 0
+#define SUCCESS_ANSWER_QUERIES 0
+#define SUCCESS_SPILL 0
+#define SUCCESS_SEARCH_FILE 0
+#define SUCCESS_OPEN_SET 0
+#define SUCCESS_EXPORT 0
 
 #define GET_LINE_NUMBER_TIMEOUT 2
 #define INVALID_LINE_NUMBER_INPUT 0
@@ -52,9 +97,7 @@ extern int errno;
 #define NULL_ERRORFDS NULL
 #define STRING_EQUAL 0
 #define READ_EOF 0
-#define TABLE_INIT_SIZE 100
 #define INPUT_SIZE 128
-#define BUFFER_SIZE 256
 #define NOT_STOP_INPUT 1
 #define TRUE 1
 #define FALSE 0
@@ -67,11 +110,139 @@ extern int errno;
 #define WITHOUT_NEW_LINE 0
 #define ANY_ADDRESS 0
 #define FILE_START_POS 0
+#define SCAN_BATCH_SIZE 4096
+#define SINGLE_THREAD 1
+#define DEFAULT_ATTR NULL
+#define IGNORE_RESULT NULL
+#define END_OF_OPTIONS -1
+#define OPTION_STRING "cilbfq:m:o:rs:uw:x:"
+#define STDIN_NAME "-"
+#define LAZY_STEP_SIZE (1024 * 1024)
+#define FOLLOW_POLL_SEC 1
+#define NO_NOTIFY -1
+#define NOTIFY_BUFFER_SIZE 4096
+#define FOLLOW_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#define STREAM_BUFFER_SIZE (1024 * 1024)
+#define SPILL_NAME_SIZE 4096
+#define SPILL_TEMPLATE "%s/lab7-XXXXXX"
+#define DEFAULT_TMP_DIR "/tmp"
+#define NSEC_PER_MSEC 1e6
+#define LINE_NUMBER_SIZE 32
+#define WHOLE_FILE LLONG_MAX
+#define NO_WINDOWS 0
+#define MIN_MEMBER_BUDGET 1
+#define BYTES_PER_MB (1024 * 1024)
+#define KB 1024
+#define SINGLE_FILE 1
+#define NO_EXPORT -1
+#define OUTPUT_FILE_MODE 0644
+#define MAX_REPORTED_ERRORS 10
+#define USAGE_FORMAT "Usage: %s [-c] [-i] [-l] [-b] [-f] [-q queries|-] [-m none|sequential|populate] [-r] [-s pattern] [-u] [-w megabytes] [-x first-last [-o output]] <filename>...\n"
 
-typedef struct line_info {
+#define OPTION_COMPACT (1 << 0)
+#define OPTION_LAZY (1 << 1)
+#define OPTION_BACKGROUND (1 << 2)
+#define OPTION_FOLLOW (1 << 3)
+#define OPTION_QUERIES (1 << 4)
+#define OPTION_PATTERN (1 << 5)
+#define OPTION_UTF8 (1 << 6)
+#define OPTION_WINDOWS (1 << 7)
+#define OPTION_EXPORT (1 << 8)
+#define OPTION_OUTPUT (1 << 9)
+#define OPTION_SEVERAL_FILES (1 << 10)
+#define OPTION_LAZY_MODES (OPTION_LAZY | OPTION_BACKGROUND | OPTION_FOLLOW)
+
+typedef struct viewer_options {
+    int compact;
+    int show_info;
+    int lazy;
+    int background;
+    int follow;
+    char *query_file;
+    map_policy policy;
+    int release;
+    char *pattern;
+    int utf8;
+    size_t window_budget;
+    line_query export_range;
+    char *output_file;
+    char *file_name;
+    char **file_names;
+    long long file_count;
+} viewer_options;
+
+typedef struct query_result {
+    long long first;
+    long long last;
+    long long first_column;
+    long long last_column;
     off_t offset;
     size_t length;
-} line_info;
+    int valid;
+} query_result;
+
+typedef struct viewed_file {
+    char *name;
+    int fildes;
+    struct stat stat;
+    char *addr;
+    window_map *windows;
+    size_t window_budget;
+    off_t size;
+    int follow;
+    int spilled;
+    map_policy policy;
+    int notify_fildes;
+    int watch;
+} viewed_file;
+
+typedef struct line_index {
+    line_info *table;
+    compact_index *compact;
+    utf8_index *utf8;
+    offset_index offsets;
+    index_cache cache;
+    map_policy *policy;
+    window_map *windows;
+    long long length;
+    int lazy;
+    int complete;
+    int background;
+    long long table_size;
+    char *file_addr;
+    off_t file_size;
+    off_t scan_offset;
+    off_t line_offset;
+    pthread_mutex_t lock;
+    pthread_t indexer;
+    int indexer_started;
+    int indexer_running;
+    int stop_indexer;
+} line_index;
+
+typedef enum member_state {
+    MEMBER_CLOSED,
+    MEMBER_MAPPED,
+    MEMBER_INDEXED
+} member_state;
+
+typedef struct set_member {
+    viewed_file file;
+    line_index index;
+    long long first_line;
+    long long length;
+    member_state state;
+} set_member;
+
+typedef struct file_set {
+    viewer_options *options;
+    set_member *members;
+    long long count;
+    long long length;
+    long long next_member;
+    size_t window_budget;
+    pthread_mutex_t lock;
+} file_set;
 
 int add_to_table(line_info **table, long long *table_size, long long *table_length, off_t line_offset, size_t line_length) {
     if (table == NULL || *table == NULL || table_size == NULL || table_length == NULL) {
@@ -80,9 +251,8 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
     }
 
     if (*table_length == *table_size) {
-        line_info *ptr = (line_info *) realloc(*table, 2 * (*table_size) * sizeof(line_info));
+        line_info *ptr = line_table_grow(*table, 2 * (*table_size));
         if (ptr == NULL) {
-            perror("Can't create table");
             return ERROR_ADD_TO_TABLE;
         }
         *table = ptr;
@@ -99,71 +269,465 @@ int add_to_table(line_info **table, long long *table_size, long long *table_leng
     return SUCCESS_ADD_TO_TABLE;
 }
 
-int fill_table(char *file_addr, off_t file_size, line_info **table, long long *table_size, long long *table_length) {
-    size_t line_length = 0;
-    off_t line_offset = 0, file_offset = 0;
+int reserve_table(line_info **table, long long *table_size, long long required_size) {
+    if (table == NULL || *table == NULL || table_size == NULL) {
+        fprintf(stderr, "Can't reserve table: Invalid argument(s)\n");
+        return ERROR_ADD_TO_TABLE;
+    }
+
+    long long new_size = *table_size;
+    while (new_size < required_size) {
+        new_size *= 2;
+    }
+    if (new_size == *table_size) {
+        return SUCCESS_ADD_TO_TABLE;
+    }
+
+    line_info *ptr = line_table_grow(*table, new_size);
+    if (ptr == NULL) {
+        return ERROR_ADD_TO_TABLE;
+    }
+    *table = ptr;
+    *table_size = new_size;
+
+    return SUCCESS_ADD_TO_TABLE;
+}
+
+int fill_block(const char *addr, off_t begin, off_t end, off_t *line_offset, line_info **table, long long *table_size, long long *table_length) {
+    off_t new_lines[SCAN_BATCH_SIZE];
+    off_t file_offset = begin;
+
+    while (file_offset < end) {
+        size_t scanned = 0;
+        size_t found = scan_newlines(addr + (file_offset - begin), end - file_offset, new_lines, SCAN_BATCH_SIZE, &scanned);
 
-    while (file_offset <= file_size) {
-        char *c = NULL;
-        if (file_offset < file_size) {
-            c = file_addr + file_offset;
+        int reserve_check = reserve_table(table, table_size, *table_length + found);
+        if (reserve_check == ERROR_ADD_TO_TABLE) {
+            return ERROR_FILL_TABLE;
         }
 
-        if (file_offset < file_size && (c != NULL && *c != '\n')) {
-            line_length++;
-            file_offset++;
-            continue;
+        line_info *elem = *table + *table_length;
+        for (size_t i = 0; i < found; i++) {
+            off_t new_line_offset = file_offset + new_lines[i];
+            elem[i].offset = *line_offset;
+            elem[i].length = new_line_offset - *line_offset;
+            *line_offset = new_line_offset + 1;
         }
+        *table_length += found;
+        file_offset += scanned;
+    }
 
-        int add_check = add_to_table(table, table_size, table_length, line_offset, line_length);
-        if (add_check == ERROR_ADD_TO_TABLE) {
+    return SUCCESS_FILL_TABLE;
+}
+
+int fill_range(char *file_addr, window_map *windows, off_t begin, off_t end, off_t *line_offset, line_info **table, long long *table_size, long long *table_length) {
+    if (windows == NULL) {
+        return fill_block(file_addr + begin, begin, end, line_offset, table, table_size, table_length);
+    }
+
+    while (begin < end) {
+        map_window *window = window_map_acquire(windows, begin);
+        if (window == NULL) {
             return ERROR_FILL_TABLE;
         }
+        size_t available;
+        const char *addr = window_data(window, begin, &available);
+        off_t block_end = (begin + (off_t) available < end) ? begin + (off_t) available : end;
 
-        line_length = 0;
-        file_offset++;
-        line_offset = file_offset;
+        int fill_check = fill_block(addr, begin, block_end, line_offset, table, table_size, table_length);
+        window_map_release(windows, window);
+        if (fill_check == ERROR_FILL_TABLE) {
+            return ERROR_FILL_TABLE;
+        }
+        begin = block_end;
     }
 
     return SUCCESS_FILL_TABLE;
 }
 
-line_info *create_table(char *file_addr, off_t file_size, long long *table_length) {
-    if (table_length == NULL) {
-        fprintf(stderr, "Can't create table: Invalid argument(s)\n");
-        return NULL;
+int extend_index_step(line_index *index) {
+    off_t end = index->scan_offset + LAZY_STEP_SIZE;
+    if (end > index->file_size) {
+        end = index->file_size;
     }
 
-    long long size = TABLE_INIT_SIZE;
-    *table_length = 0;
-    line_info *table = (line_info *) malloc(size * sizeof(line_info));
-    if (table == NULL) {
-        perror("Can't create table");
-        return NULL;
+    int fill_check = fill_range(index->file_addr, index->windows, index->scan_offset, end, &index->line_offset,
+                                &index->table, &index->table_size, &index->length);
+    if (fill_check == ERROR_FILL_TABLE) {
+        return ERROR_EXTEND_INDEX;
     }
+    index->scan_offset = end;
+    map_policy_indexed(index->policy, index->file_addr, index->scan_offset);
 
-    int fill_check = fill_table(file_addr, file_size, &table, &size, table_length);
-    if (fill_check == ERROR_FILL_TABLE) {
-        free(table);
-        return NULL;
+    if (index->scan_offset == index->file_size) {
+        int add_check = add_to_table(&index->table, &index->table_size, &index->length,
+                                     index->line_offset, index->file_size - index->line_offset);
+        if (add_check == ERROR_ADD_TO_TABLE) {
+            return ERROR_EXTEND_INDEX;
+        }
+        index->complete = TRUE;
+        map_policy_lookup(index->policy, index->file_addr, index->file_size);
+    }
+    return SUCCESS_EXTEND_INDEX;
+}
+
+int extend_index(line_index *index, long long line_num) {
+    if (index->lazy == FALSE) {
+        return SUCCESS_EXTEND_INDEX;
     }
 
-    return table;
+    int result = SUCCESS_EXTEND_INDEX;
+    pthread_mutex_lock(&index->lock);
+    while (result == SUCCESS_EXTEND_INDEX && index->complete == FALSE && index->length < line_num) {
+        result = extend_index_step(index);
+    }
+    pthread_mutex_unlock(&index->lock);
+    return result;
 }
 
-int write_to_console(const char *buf, int length, int new_line) {
-    ssize_t write_check = write(STDOUT_FILENO, buf, length);
-    if (write_check == ERROR_WRITE) {
+void *index_in_background(void *arg) {
+    line_index *index = (line_index *) arg;
+
+    while (TRUE) {
+        pthread_mutex_lock(&index->lock);
+        if (index->stop_indexer == TRUE || index->complete == TRUE) {
+            index->indexer_running = FALSE;
+            pthread_mutex_unlock(&index->lock);
+            break;
+        }
+        int extend_check = extend_index_step(index);
+        if (extend_check == ERROR_EXTEND_INDEX) {
+            index->indexer_running = FALSE;
+            pthread_mutex_unlock(&index->lock);
+            break;
+        }
+        pthread_mutex_unlock(&index->lock);
+    }
+    return NULL;
+}
+
+void start_background_index(line_index *index) {
+    if (index->background == FALSE || index->indexer_running == TRUE) {
+        return;
+    }
+    if (index->indexer_started == TRUE) {
+        pthread_join(index->indexer, IGNORE_RESULT);
+        index->indexer_started = FALSE;
+    }
+
+    index->indexer_running = TRUE;
+    int create_check = pthread_create(&index->indexer, DEFAULT_ATTR, index_in_background, index);
+    if (create_check != NO_ERROR) {
+        fprintf(stderr, "Can't create thread: %s\n", strerror(create_check));
+        index->indexer_running = FALSE;
+        return;
+    }
+    index->indexer_started = TRUE;
+}
+
+int start_lazy_index(line_index *index, char *file_addr, off_t file_size, long long expected_length, int background) {
+    index->table_size = expected_length;
+    index->table = line_table_create(index->table_size);
+    if (index->table == NULL) {
+        return ERROR_EXTEND_INDEX;
+    }
+
+    index->lazy = TRUE;
+    index->background = background;
+    index->file_addr = file_addr;
+    index->file_size = file_size;
+    index->scan_offset = 0;
+    index->line_offset = 0;
+    pthread_mutex_init(&index->lock, DEFAULT_ATTR);
+
+    start_background_index(index);
+    return SUCCESS_EXTEND_INDEX;
+}
+
+void stop_lazy_index(line_index *index) {
+    if (index->indexer_started == TRUE) {
+        pthread_mutex_lock(&index->lock);
+        index->stop_indexer = TRUE;
+        pthread_mutex_unlock(&index->lock);
+        pthread_join(index->indexer, IGNORE_RESULT);
+        index->indexer_started = FALSE;
+    }
+    pthread_mutex_destroy(&index->lock);
+    index->lazy = FALSE;
+}
+
+int write_to_console(const char *buf, size_t length, int new_line) {
+    struct iovec iov[2];
+    iov[0].iov_base = (void *) buf;
+    iov[0].iov_len = length;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+
+    int write_check = write_vector(STDOUT_FILENO, iov, (new_line == WITH_NEW_LINE) ? 2 : 1);
+    if (write_check == OUTPUT_ERROR) {
         perror("Can't write to console");
         return ERROR_WRITE;
     }
-    if (new_line == WITH_NEW_LINE) {
-        return write_to_console("\n", 1, WITHOUT_NEW_LINE);
-    }
     return SUCCESS_WRITE;
 }
 
-int wait_for_input() {
+int output_windowed(output_buffer *out, viewed_file *file, off_t offset, size_t length) {
+    while (length > 0) {
+        map_window *window = window_map_acquire(file->windows, offset);
+        if (window == NULL) {
+            return OUTPUT_ERROR;
+        }
+        size_t available;
+        const char *addr = window_data(window, offset, &available);
+        size_t part = (length < available) ? length : available;
+
+        int output_check = output_append(out, addr, part);
+        window_map_release(file->windows, window);
+        if (output_check == OUTPUT_ERROR) {
+            return OUTPUT_ERROR;
+        }
+        offset += part;
+        length -= part;
+    }
+    return OUTPUT_SUCCESS;
+}
+
+int output_line(output_buffer *out, viewed_file *file, off_t offset, size_t length) {
+    if (file->windows != NULL) {
+        int output_check = output_windowed(out, file, offset, length);
+        if (output_check == OUTPUT_SUCCESS) {
+            output_check = output_append(out, "\n", 1);
+        }
+        return output_check;
+    }
+
+    if (offset + (off_t) length < file->size) {
+        return output_reference(out, file->addr + offset, length + 1);
+    }
+
+    int output_check = output_reference(out, file->addr + offset, length);
+    if (output_check == OUTPUT_SUCCESS) {
+        output_check = output_append(out, "\n", 1);
+    }
+    return output_check;
+}
+
+int map_file(viewed_file *file) {
+    file->addr = NULL;
+    file->windows = NULL;
+    if (file->size == 0) {
+        return SUCCESS_MAP_FILE;
+    }
+
+    if (file->window_budget != NO_WINDOWS) {
+        file->windows = window_map_create(file->fildes, file->size, file->window_budget);
+        return (file->windows == NULL) ? ERROR_MAP_FILE : SUCCESS_MAP_FILE;
+    }
+
+    char *file_addr = (char *) mmap(ANY_ADDRESS, file->size, PROT_READ, MAP_SHARED | map_policy_flags(&file->policy), file->fildes, FILE_START_POS);
+    if (file_addr == MAP_FAILED) {
+        perror("Can't map file");
+        return ERROR_MAP_FILE;
+    }
+    file->addr = file_addr;
+    return SUCCESS_MAP_FILE;
+}
+
+int unmap_file(viewed_file *file) {
+    if (file->windows != NULL) {
+        window_map_destroy(file->windows);
+        file->windows = NULL;
+        return SUCCESS_MAP_FILE;
+    }
+    if (file->addr == NULL) {
+        return SUCCESS_MAP_FILE;
+    }
+
+    int munmap_check = munmap(file->addr, file->size);
+    file->addr = NULL;
+    if (munmap_check == ERROR_MUNMAP) {
+        perror("Can't clean memory");
+        return ERROR_MAP_FILE;
+    }
+    return SUCCESS_MAP_FILE;
+}
+
+int remap_file(viewed_file *file, off_t new_size) {
+    if (file->addr == NULL) {
+        file->size = new_size;
+        return map_file(file);
+    }
+    if (new_size == 0) {
+        unmap_file(file);
+        file->size = 0;
+        return SUCCESS_MAP_FILE;
+    }
+
+    char *file_addr = (char *) mremap(file->addr, file->size, new_size, MREMAP_MAYMOVE);
+    if (file_addr == MAP_FAILED) {
+        perror("Can't remap file");
+        return ERROR_MAP_FILE;
+    }
+    file->addr = file_addr;
+    file->size = new_size;
+    return SUCCESS_MAP_FILE;
+}
+
+void start_follow(viewed_file *file) {
+    file->notify_fildes = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (file->notify_fildes == ERROR_INOTIFY) {
+        perror("Can't watch file, falling back to polling");
+        file->notify_fildes = NO_NOTIFY;
+        return;
+    }
+
+    file->watch = inotify_add_watch(file->notify_fildes, file->name, FOLLOW_EVENTS);
+    if (file->watch == ERROR_INOTIFY) {
+        perror("Can't watch file, falling back to polling");
+        close(file->notify_fildes);
+        file->notify_fildes = NO_NOTIFY;
+    }
+}
+
+void stop_follow(viewed_file *file) {
+    if (file->notify_fildes != NO_NOTIFY) {
+        close(file->notify_fildes);
+        file->notify_fildes = NO_NOTIFY;
+    }
+}
+
+void drain_notify_events(viewed_file *file) {
+    char events[NOTIFY_BUFFER_SIZE];
+    while (read(file->notify_fildes, events, NOTIFY_BUFFER_SIZE) > 0) {
+    }
+}
+
+void reset_index(line_index *index, viewed_file *file) {
+    index->file_addr = file->addr;
+    index->file_size = file->size;
+    index->length = 0;
+    index->scan_offset = 0;
+    index->line_offset = 0;
+    index->complete = FALSE;
+    map_policy_reset(index->policy);
+}
+
+int reopen_file(viewed_file *file, line_index *index) {
+    int fildes = open(file->name, O_RDONLY);
+    if (fildes == ERROR_OPEN_FILE) {
+        return SUCCESS_FOLLOW_FILE;
+    }
+    struct stat new_stat;
+    int fstat_check = fstat(fildes, &new_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get file stat");
+        close(fildes);
+        return ERROR_FOLLOW_FILE;
+    }
+
+    pthread_mutex_lock(&index->lock);
+    unmap_file(file);
+    close(file->fildes);
+    file->fildes = fildes;
+    file->stat = new_stat;
+    file->size = new_stat.st_size;
+    int map_check = map_file(file);
+    if (map_check == ERROR_MAP_FILE) {
+        file->size = 0;
+    }
+    reset_index(index, file);
+    pthread_mutex_unlock(&index->lock);
+
+    if (file->notify_fildes != NO_NOTIFY) {
+        inotify_rm_watch(file->notify_fildes, file->watch);
+        file->watch = inotify_add_watch(file->notify_fildes, file->name, FOLLOW_EVENTS);
+    }
+    start_background_index(index);
+    return (map_check == ERROR_MAP_FILE) ? ERROR_FOLLOW_FILE : SUCCESS_FOLLOW_FILE;
+}
+
+int follow_file(viewed_file *file, line_index *index) {
+    if (file->notify_fildes != NO_NOTIFY) {
+        drain_notify_events(file);
+    }
+
+    struct stat path_stat;
+    int stat_check = stat(file->name, &path_stat);
+    if (stat_check != ERROR_STAT && (path_stat.st_ino != file->stat.st_ino || path_stat.st_dev != file->stat.st_dev)) {
+        return reopen_file(file, index);
+    }
+
+    struct stat new_stat;
+    int fstat_check = fstat(file->fildes, &new_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get file stat");
+        return ERROR_FOLLOW_FILE;
+    }
+    if (new_stat.st_size == file->size) {
+        return SUCCESS_FOLLOW_FILE;
+    }
+
+    pthread_mutex_lock(&index->lock);
+    off_t old_size = file->size;
+    int remap_check = remap_file(file, new_stat.st_size);
+    if (remap_check == ERROR_MAP_FILE) {
+        pthread_mutex_unlock(&index->lock);
+        return ERROR_FOLLOW_FILE;
+    }
+    file->stat = new_stat;
+
+    if (new_stat.st_size < old_size) {
+        reset_index(index, file);
+    } else {
+        index->file_addr = file->addr;
+        index->file_size = file->size;
+        if (index->complete == TRUE) {
+            index->length--;
+            index->complete = FALSE;
+        }
+    }
+    pthread_mutex_unlock(&index->lock);
+
+    start_background_index(index);
+    return SUCCESS_FOLLOW_FILE;
+}
+
+int wait_for_file_or_input(viewed_file *file, line_index *index) {
+    while (TRUE) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(STDIN_FILENO, &readfds);
+        int max_fildes = STDIN_FILENO;
+        if (file->notify_fildes != NO_NOTIFY) {
+            FD_SET(file->notify_fildes, &readfds);
+            max_fildes = file->notify_fildes;
+        }
+
+        struct timeval timeout;
+        timeout.tv_sec = FOLLOW_POLL_SEC;
+        timeout.tv_usec = TIMEOUT_USEC;
+
+        int select_check = select(max_fildes + 1, &readfds, NULL_WRITEFDS, NULL_ERRORFDS, &timeout);
+        if (select_check == ERROR_SELECT) {
+            perror("Select error");
+            return ERROR_SELECT;
+        }
+
+        int follow_check = follow_file(file, index);
+        if (follow_check == ERROR_FOLLOW_FILE) {
+            return ERROR_SELECT;
+        }
+        if (select_check != SELECT_NO_REACTION && FD_ISSET(STDIN_FILENO, &readfds)) {
+            return SUCCESS_SELECT;
+        }
+    }
+}
+
+int wait_for_input(viewed_file *file, line_index *index) {
+    if (file->follow == TRUE) {
+        return wait_for_file_or_input(file, index);
+    }
+
     fd_set readfds;
     FD_ZERO(&readfds);
     FD_SET(STDIN_FILENO, &readfds);
@@ -212,8 +776,8 @@ int validate_strtoll(char *endptr) {
     return SUCCESS_STRTOLL;
 }
 
-int read_from_console(char *input, size_t size) {
-    int wait_check = wait_for_input();
+int read_from_console(viewed_file *file, line_index *index, char *input, size_t size) {
+    int wait_check = wait_for_input(file, index);
     if (wait_check == ERROR_SELECT) {
         return ERROR_READ;
     }
@@ -233,7 +797,7 @@ int read_from_console(char *input, size_t size) {
     return SUCCESS_READ;
 }
 
-int get_line_number(long long *line_num) {
+int get_line_number(viewed_file *file, line_index *index, long long *line_num) {
     char input[INPUT_SIZE + 1];
 
     int write_check = write_to_console("Five seconds to enter line number: ", 35, WITHOUT_NEW_LINE);
@@ -241,7 +805,7 @@ int get_line_number(long long *line_num) {
         return ERROR_GET_LINE_NUMBER;
     }
 
-    int read_check = read_from_console(input, INPUT_SIZE);
+    int read_check = read_from_console(file, index, input, INPUT_SIZE);
     switch (read_check) {
         case ERROR_READ:
             return ERROR_GET_LINE_NUMBER;
@@ -252,6 +816,7 @@ int get_line_number(long long *line_num) {
     }
 
     char *endptr = input;
+    errno = NO_ERROR;
     *line_num = strtoll(input, &endptr, DECIMAL_SYSTEM);
 
     int strtoll_check = validate_strtoll(endptr);
@@ -262,19 +827,10 @@ int get_line_number(long long *line_num) {
     return SUCCESS_GET_LINE_NUMBER;
 }
 
-int print_file(char *file_addr, off_t file_size) {
-    off_t file_offset = 0;
-    while (file_offset < file_size) {
-        int write_size = BUFFER_SIZE;
-        if (file_size - file_offset < BUFFER_SIZE) {
-            write_size = file_size - file_offset;
-        }
-
-        int write_check = write_to_console(file_addr + file_offset, write_size, WITHOUT_NEW_LINE);
-        if (write_check == ERROR_WRITE) {
-            return ERROR_PRINT_FILE;
-        }
-        file_offset += write_size;
+int print_file(viewed_file *file) {
+    int dump_check = dump_file(file->fildes, FILE_START_POS, file->size, STDOUT_FILENO);
+    if (dump_check == DUMP_ERROR) {
+        return ERROR_PRINT_FILE;
     }
 
     int write_check = write_to_console("\n", 1, WITHOUT_NEW_LINE);
@@ -285,24 +841,190 @@ int print_file(char *file_addr, off_t file_size) {
     return SUCCESS_PRINT_FILE;
 }
 
-int open_file(int argc, char** argv, int *fildes, off_t *file_size) {
-    if (argc < 2) {
-        printf("Usage: %s <filename>\n", argv[0]);
-        return ERROR_OPEN_FILE;
+int parse_window_budget(const char *text, size_t *budget) {
+    char *endptr = NULL;
+    errno = NO_ERROR;
+    long long megabytes = strtoll(text, &endptr, DECIMAL_SYSTEM);
+    if (errno != NO_ERROR || endptr == text || *endptr != '\0' || megabytes <= 0 || megabytes > (long long) (SIZE_MAX / BYTES_PER_MB)) {
+        fprintf(stderr, "Window budget has to be a positive number of megabytes\n");
+        return ERROR_PARSE_OPTIONS;
+    }
+    *budget = megabytes * BYTES_PER_MB;
+    return SUCCESS_PARSE_OPTIONS;
+}
+
+int parse_export_range(const char *text, line_query *range) {
+    line_query *queries;
+    long long queries_length;
+    int parse_check = parse_queries(text, strlen(text), &queries, &queries_length);
+    if (parse_check == LINE_QUERY_ERROR || queries_length != 1 || queries[0].first_column != LINE_QUERY_NO_COLUMNS) {
+        fprintf(stderr, "Export range has to be a single line range like 10-20\n");
+        free(queries);
+        return ERROR_PARSE_OPTIONS;
+    }
+    *range = queries[0];
+    free(queries);
+    return SUCCESS_PARSE_OPTIONS;
+}
+
+/*
+ * Option pairs that can't be used together; a pair is rejected when at
+ * least one option of each mask was given.
+ */
+typedef struct option_conflict {
+    int first;
+    int second;
+    const char *message;
+} option_conflict;
+
+static const option_conflict option_conflicts[] = {
+    {OPTION_COMPACT, OPTION_FOLLOW, "-c can't be used with -f: the compact index can't grow with the file"},
+    {OPTION_QUERIES, OPTION_FOLLOW, "-q can't be used with -f: queries are answered once, not while following"},
+    {OPTION_PATTERN, OPTION_FOLLOW, "-s can't be used with -f: the search runs once over the whole file"},
+    {OPTION_PATTERN, OPTION_QUERIES, "-s can't be used with -q: either search or answer queries"},
+    {OPTION_WINDOWS, OPTION_FOLLOW, "-w can't be used with -f: windows are laid out for a fixed file size"},
+    {OPTION_WINDOWS, OPTION_PATTERN, "-w can't be used with -s: the search needs the whole file mapped"},
+    {OPTION_UTF8, OPTION_LAZY_MODES, "-u can't be used with -l, -b or -f: the column index needs every line indexed first"},
+    {OPTION_UTF8, OPTION_WINDOWS, "-u can't be used with -w: the column index needs the whole file mapped"},
+    {OPTION_EXPORT, OPTION_FOLLOW, "-x can't be used with -f: the exported range is fixed when it is copied"},
+    {OPTION_EXPORT, OPTION_QUERIES, "-x can't be used with -q: either export a range or answer queries"},
+    {OPTION_EXPORT, OPTION_PATTERN, "-x can't be used with -s: either export a range or search"},
+    {OPTION_EXPORT, OPTION_UTF8, "-x can't be used with -u: whole lines are exported, not columns"},
+    {OPTION_SEVERAL_FILES, OPTION_LAZY_MODES, "Several files can't be viewed with -l, -b or -f"},
+    {OPTION_SEVERAL_FILES, OPTION_PATTERN, "Several files can't be searched with -s"},
+    {OPTION_SEVERAL_FILES, OPTION_UTF8, "Several files can't be viewed with -u"},
+    {OPTION_SEVERAL_FILES, OPTION_EXPORT, "Several files can't be exported from with -x"},
+};
+
+int check_option_conflicts(int given) {
+    for (size_t i = 0; i < sizeof(option_conflicts) / sizeof(option_conflict); i++) {
+        if ((given & option_conflicts[i].first) != 0 && (given & option_conflicts[i].second) != 0) {
+            fprintf(stderr, "%s\n", option_conflicts[i].message);
+            return ERROR_PARSE_OPTIONS;
+        }
     }
-    *fildes = open(argv[1], O_RDONLY);
+    if ((given & OPTION_OUTPUT) != 0 && (given & OPTION_EXPORT) == 0) {
+        fprintf(stderr, "-o only names the target of -x\n");
+        return ERROR_PARSE_OPTIONS;
+    }
+    return SUCCESS_PARSE_OPTIONS;
+}
+
+int parse_options(int argc, char **argv, viewer_options *options) {
+    options->compact = FALSE;
+    options->show_info = FALSE;
+    options->lazy = FALSE;
+    options->background = FALSE;
+    options->follow = FALSE;
+    options->query_file = NULL;
+    options->policy.scan = SCAN_SEQUENTIAL;
+    options->release = FALSE;
+    options->pattern = NULL;
+    options->utf8 = FALSE;
+    options->window_budget = NO_WINDOWS;
+    options->export_range.first = NO_EXPORT;
+    options->output_file = NULL;
+    options->file_name = NULL;
+
+    int given = 0;
+    int option;
+    while ((option = getopt(argc, argv, OPTION_STRING)) != END_OF_OPTIONS) {
+        switch (option) {
+            case 'c':
+                given |= OPTION_COMPACT;
+                options->compact = TRUE;
+                break;
+            case 'i':
+                options->show_info = TRUE;
+                break;
+            case 'l':
+                given |= OPTION_LAZY;
+                options->lazy = TRUE;
+                break;
+            case 'b':
+                given |= OPTION_BACKGROUND;
+                options->lazy = TRUE;
+                options->background = TRUE;
+                break;
+            case 'f':
+                given |= OPTION_FOLLOW;
+                options->lazy = TRUE;
+                options->follow = TRUE;
+                break;
+            case 'q':
+                given |= OPTION_QUERIES;
+                options->query_file = optarg;
+                break;
+            case 'o':
+                given |= OPTION_OUTPUT;
+                options->output_file = optarg;
+                break;
+            case 'm':
+                if (parse_map_policy(optarg, &options->policy) == MAP_POLICY_ERROR) {
+                    return ERROR_PARSE_OPTIONS;
+                }
+                break;
+            case 'r':
+                options->release = TRUE;
+                break;
+            case 's':
+                given |= OPTION_PATTERN;
+                options->pattern = optarg;
+                break;
+            case 'u':
+                given |= OPTION_UTF8;
+                options->utf8 = TRUE;
+                break;
+            case 'w':
+                given |= OPTION_WINDOWS;
+                if (parse_window_budget(optarg, &options->window_budget) == ERROR_PARSE_OPTIONS) {
+                    return ERROR_PARSE_OPTIONS;
+                }
+                break;
+            case 'x':
+                given |= OPTION_EXPORT;
+                if (parse_export_range(optarg, &options->export_range) == ERROR_PARSE_OPTIONS) {
+                    return ERROR_PARSE_OPTIONS;
+                }
+                break;
+            default:
+                printf(USAGE_FORMAT, argv[0]);
+                return ERROR_PARSE_OPTIONS;
+        }
+    }
+
+    if (optind >= argc) {
+        printf(USAGE_FORMAT, argv[0]);
+        return ERROR_PARSE_OPTIONS;
+    }
+    if (argc - optind > SINGLE_FILE) {
+        given |= OPTION_SEVERAL_FILES;
+    }
+    if (check_option_conflicts(given) == ERROR_PARSE_OPTIONS) {
+        return ERROR_PARSE_OPTIONS;
+    }
+    if (options->pattern != NULL && (options->pattern[0] == '\0' || strchr(options->pattern, '\n') != NULL)) {
+        fprintf(stderr, "Search pattern has to be a non-empty string without new lines\n");
+        return ERROR_PARSE_OPTIONS;
+    }
+    options->file_name = argv[optind];
+    options->file_names = &argv[optind];
+    options->file_count = argc - optind;
+    return SUCCESS_PARSE_OPTIONS;
+}
+
+int open_file(const char *file_name, int *fildes, struct stat *file_stat) {
+    *fildes = open(file_name, O_RDONLY);
     if (*fildes == ERROR_OPEN_FILE) {
         perror("Can't open file");
         return ERROR_OPEN_FILE;
     }
 
-    struct stat st;
-    int fstat_check = fstat(*fildes, &st);
+    int fstat_check = fstat(*fildes, file_stat);
     if (fstat_check == ERROR_FSTAT) {
         perror("Can't get file stat");
         return ERROR_OPEN_FILE;
     }
-    *file_size = st.st_size;
 
     return SUCCESS_OPEN_FILE;
 }
@@ -316,81 +1038,1164 @@ int close_file(int fildes) {
     return SUCCESS_CLOSE_FILE;
 }
 
-int print_line(char *file_addr, line_info *table, long long line_num) {
-    off_t line_offset = table[line_num - 1].offset;
-    size_t line_length = table[line_num - 1].length;
+int is_streamed(int fildes, struct stat *file_stat) {
+    if (!S_ISREG(file_stat->st_mode)) {
+        return TRUE;
+    }
+    if (file_stat->st_size != 0) {
+        return FALSE;
+    }
+    char probe;
+    return pread(fildes, &probe, 1, FILE_START_POS) > 0;
+}
 
-    int write_check = write_to_console(file_addr + line_offset, line_length, WITH_NEW_LINE);
-    if (write_check == ERROR_WRITE) {
-        return ERROR_PRINT_LINE;
+int create_spill_file(int *spill_fildes) {
+    const char *tmp_dir = getenv("TMPDIR");
+    if (tmp_dir == NULL) {
+        tmp_dir = DEFAULT_TMP_DIR;
     }
 
-    return SUCCESS_PRINT_LINE;
+    char name[SPILL_NAME_SIZE];
+    snprintf(name, SPILL_NAME_SIZE, SPILL_TEMPLATE, tmp_dir);
+    *spill_fildes = mkstemp(name);
+    if (*spill_fildes == ERROR_OPEN_FILE) {
+        perror("Can't create backing file");
+        return ERROR_SPILL;
+    }
+    unlink(name);
+    return SUCCESS_SPILL;
 }
 
-int print_lines(char *file_addr, off_t file_size, line_info *table, long long table_length) {
-    if (table == NULL) {
-        return ERROR_PRINT_LINES;
+int copy_stream(int fildes, int spill_fildes, off_t *size) {
+    char *buf = (char *) malloc(STREAM_BUFFER_SIZE);
+    if (buf == NULL) {
+        perror("Can't copy file");
+        return ERROR_SPILL;
     }
 
-    long long line_num;
-    while (NOT_STOP_INPUT) {
-        int get_line_num_check = get_line_number(&line_num);
-
-        if (get_line_num_check == ERROR_GET_LINE_NUMBER) {
-            break;
-        }
-        if (get_line_num_check == INVALID_LINE_NUMBER_INPUT) {
-            continue;
+    *size = 0;
+    while (TRUE) {
+        ssize_t bytes_read = read(fildes, buf, STREAM_BUFFER_SIZE);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read from file");
+            free(buf);
+            return ERROR_SPILL;
         }
-        if (get_line_num_check == GET_LINE_NUMBER_TIMEOUT) {
-            print_file(file_addr, file_size);
+        if (bytes_read == READ_EOF) {
             break;
         }
-        if (line_num < 0 || line_num > table_length) {
-            fprintf(stderr, "Invalid line number. It has to be in range [0, %lld]\n", table_length);
-            continue;
+
+        int write_check = write_all(spill_fildes, buf, bytes_read);
+        if (write_check == OUTPUT_ERROR) {
+            perror("Can't write to backing file");
+            free(buf);
+            return ERROR_SPILL;
         }
-        if (line_num == STOP_INPUT) {
+        *size += bytes_read;
+    }
+
+    free(buf);
+    return SUCCESS_SPILL;
+}
+
+int spill_file(viewed_file *file) {
+    int spill_fildes;
+    int spill_check = create_spill_file(&spill_fildes);
+    if (spill_check == ERROR_SPILL) {
+        return ERROR_SPILL;
+    }
+
+    off_t size;
+    spill_check = copy_stream(file->fildes, spill_fildes, &size);
+    if (spill_check == ERROR_SPILL) {
+        close(spill_fildes);
+        return ERROR_SPILL;
+    }
+
+    close_file(file->fildes);
+    file->fildes = spill_fildes;
+    file->size = size;
+    file->spilled = TRUE;
+    if (file->follow == TRUE) {
+        fprintf(stderr, "Can't follow a stream, showing what was read\n");
+        file->follow = FALSE;
+    }
+    return SUCCESS_SPILL;
+}
+
+compact_index *build_compact_windowed(viewed_file *file) {
+    compact_index *compact = compact_index_create();
+    if (compact == NULL) {
+        return NULL;
+    }
+
+    off_t offset = 0;
+    int add_check = compact_index_add(compact, 0);
+    while (add_check == COMPACT_INDEX_SUCCESS && offset < file->size) {
+        map_window *window = window_map_acquire(file->windows, offset);
+        if (window == NULL) {
+            add_check = COMPACT_INDEX_ERROR;
             break;
         }
+        size_t available;
+        const char *addr = window_data(window, offset, &available);
+        add_check = compact_index_scan(compact, addr, offset, available);
+        window_map_release(file->windows, window);
+        offset += available;
+    }
 
-        int print_line_check = print_line(file_addr, table, line_num);
-        if (print_line_check == ERROR_PRINT_LINE) {
-            return ERROR_PRINT_LINES;
-        }
+    if (add_check == COMPACT_INDEX_ERROR || compact_index_finish(compact, file->size) == COMPACT_INDEX_ERROR) {
+        compact_index_destroy(compact);
+        return NULL;
     }
-    return SUCCESS_PRINT_LINES;
+    return compact;
 }
 
-int main(int argc, char** argv) {
-    int fildes;
-    off_t file_size;
+compact_index *build_compact_mapped(viewed_file *file) {
+    compact_index *compact = compact_index_create();
+    if (compact == NULL) {
+        return NULL;
+    }
 
-    int open_check = open_file(argc, argv, &fildes, &file_size);
-    if (open_check == ERROR_OPEN_FILE) {
-        return 0;
+    off_t offset = 0;
+    int add_check = compact_index_add(compact, 0);
+    while (add_check == COMPACT_INDEX_SUCCESS && offset < file->size) {
+        off_t step = (file->size - offset < MAP_POLICY_RELEASE_STEP) ? file->size - offset : MAP_POLICY_RELEASE_STEP;
+        add_check = compact_index_scan(compact, file->addr + offset, offset, step);
+        offset += step;
+        map_policy_indexed(&file->policy, file->addr, offset);
     }
 
-    char *file_addr = (char *) mmap(ANY_ADDRESS, file_size, PROT_READ, MAP_SHARED, fildes, FILE_START_POS);
-    if (file_addr == MAP_FAILED) {
-        perror("Can't map file");
-        return 0;
+    if (add_check == COMPACT_INDEX_ERROR || compact_index_finish(compact, file->size) == COMPACT_INDEX_ERROR) {
+        compact_index_destroy(compact);
+        return NULL;
     }
+    return compact;
+}
+
+int open_offset_index(viewed_file *file, line_index *index) {
+    const char *cache_name = (file->spilled == FALSE) ? file->name : NULL;
+    int open_check = offset_index_open(&index->offsets, &index->cache, cache_name, &file->stat, file->fildes,
+                                       file->addr, file->windows, index->policy, file->size);
+    if (open_check == OFFSET_INDEX_ERROR) {
+        return ERROR_OPEN_INDEX;
+    }
+    index->length = index->offsets.length;
+    return SUCCESS_OPEN_INDEX;
+}
 
-    long long table_length = 0, line_num = 0;
-    line_info *table = create_table(file_addr, file_size, &table_length);
-    print_lines(file_addr, file_size, table, table_length);
+int open_index(viewer_options *options, viewed_file *file, line_index *index) {
+    index->table = NULL;
+    index->compact = NULL;
+    index->utf8 = NULL;
+    index->offsets.width = OFFSET_WIDTH_NONE;
+    index->cache.addr = NULL;
+    index->cache.size = 0;
+    index->length = 0;
+    index->lazy = FALSE;
+    index->complete = TRUE;
+    index->background = FALSE;
+    index->indexer_started = FALSE;
+    index->indexer_running = FALSE;
+    index->stop_indexer = FALSE;
+    index->policy = &file->policy;
+    index->windows = file->windows;
 
-    if (table != NULL) {
-        free(table);
+    if (options->compact == TRUE) {
+        map_policy_scan(index->policy, file->addr, file->size);
+        index->compact = (file->windows != NULL) ? build_compact_windowed(file) : build_compact_mapped(file);
+        if (index->compact == NULL) {
+            return ERROR_OPEN_INDEX;
+        }
+        index->length = index->compact->length;
+        map_policy_indexed(index->policy, file->addr, file->size);
+        map_policy_lookup(index->policy, file->addr, file->size);
+        return SUCCESS_OPEN_INDEX;
     }
 
-    int munmap_check = munmap(file_addr, file_size);
-    if (munmap_check == ERROR_MUNMAP) {
-        perror("Can't clean memory");
+    if (options->lazy == FALSE) {
+        return open_offset_index(file, index);
     }
 
-    close_file(fildes);
-    return 0;
+    if (options->follow == FALSE && file->spilled == FALSE) {
+        index->table = (line_info *) load_index_cache(file->name, &file->stat, sizeof(line_info), &index->length, &index->cache);
+        if (index->table != NULL) {
+            map_policy_lookup(index->policy, file->addr, file->size);
+            return SUCCESS_OPEN_INDEX;
+        }
+    }
+
+    map_policy_scan(index->policy, file->addr, file->size);
+    long long expected_length = estimate_line_count(file->fildes, file->size);
+    index->complete = FALSE;
+    return start_lazy_index(index, file->addr, file->size, expected_length, options->background);
 }
+
+void close_index(viewed_file *file, line_index *index) {
+    if (index->lazy == TRUE) {
+        stop_lazy_index(index);
+        if (index->complete == TRUE && file->spilled == FALSE) {
+            save_index_cache(file->name, &file->stat, index->table, sizeof(line_info), index->length);
+        }
+    }
+
+    utf8_index_destroy(index->utf8);
+    index->utf8 = NULL;
+    if (index->compact != NULL) {
+        compact_index_destroy(index->compact);
+    } else if (index->offsets.width != OFFSET_WIDTH_NONE) {
+        offset_index_close(&index->offsets, &index->cache);
+    } else if (index->cache.addr != NULL) {
+        close_index_cache(&index->cache);
+    } else if (index->table != NULL) {
+        line_table_free(index->table);
+    }
+    index->table = NULL;
+    index->compact = NULL;
+    index->length = 0;
+}
+
+long long index_length(line_index *index) {
+    if (index->lazy == FALSE) {
+        return index->length;
+    }
+
+    pthread_mutex_lock(&index->lock);
+    long long length = index->length;
+    pthread_mutex_unlock(&index->lock);
+    return length;
+}
+
+size_t index_bytes(line_index *index) {
+    if (index->compact != NULL) {
+        return compact_index_bytes(index->compact);
+    }
+    if (index->offsets.width != OFFSET_WIDTH_NONE) {
+        return offset_index_bytes(&index->offsets);
+    }
+    return index_length(index) * sizeof(line_info);
+}
+
+void print_map_info(const char *phase, viewed_file *file, map_counters *from, map_counters *to) {
+    if (file->windows != NULL) {
+        fprintf(stderr, "%s: %d windows of %zu kB, %lld mappings, %.1f ms, %ld minor faults, %ld major faults, %ld kB resident\n",
+                phase, file->windows->window_count, file->windows->window_size / KB, file->windows->mappings,
+                (to->time_nsec - from->time_nsec) / NSEC_PER_MSEC, to->minor_faults - from->minor_faults, to->major_faults - from->major_faults, to->rss_kb);
+        return;
+    }
+    fprintf(stderr, "%s: policy %s%s%s, %.1f ms, %ld minor faults, %ld major faults, %ld kB resident\n",
+            phase, map_policy_name(&file->policy),
+            (file->policy.huge_pages == TRUE) ? ", huge pages" : "",
+            (file->policy.release_indexed == TRUE) ? ", releasing indexed pages" : "",
+            (to->time_nsec - from->time_nsec) / NSEC_PER_MSEC, to->minor_faults - from->minor_faults, to->major_faults - from->major_faults, to->rss_kb);
+}
+
+void print_index_info(line_index *index) {
+    size_t bytes = index_bytes(index);
+    long long length = index_length(index);
+    double bytes_per_line = (length > 0) ? (double) bytes / length : 0.0;
+
+    const char *kind = "table";
+    if (index->compact != NULL) {
+        kind = "compact";
+    } else if (index->offsets.width == OFFSET_WIDTH_32) {
+        kind = "32-bit offsets";
+    } else if (index->offsets.width == OFFSET_WIDTH_64) {
+        kind = "64-bit offsets";
+    }
+    if (index->cache.addr != NULL) {
+        fprintf(stderr, "Index: %s, loaded from cache, %lld lines, %zu bytes, %.3f bytes per line\n", kind, length, bytes, bytes_per_line);
+        return;
+    }
+    fprintf(stderr, "Index: %s, %s kernel, %lld lines, %zu bytes, %.3f bytes per line\n",
+            kind, newline_scan_kernel(), length, bytes, bytes_per_line);
+}
+
+int get_line_info(line_index *index, long long line_num, line_info *line) {
+    if (index->compact != NULL) {
+        int get_check = compact_index_get(index->compact, line_num - 1, line);
+        if (get_check == COMPACT_INDEX_ERROR) {
+            return ERROR_GET_LINE_INFO;
+        }
+        return SUCCESS_GET_LINE_INFO;
+    }
+    if (index->offsets.width != OFFSET_WIDTH_NONE) {
+        offset_index_get(&index->offsets, line_num - 1, line);
+        return SUCCESS_GET_LINE_INFO;
+    }
+
+    if (index->lazy == TRUE) {
+        pthread_mutex_lock(&index->lock);
+        *line = index->table[line_num - 1];
+        pthread_mutex_unlock(&index->lock);
+        return SUCCESS_GET_LINE_INFO;
+    }
+
+    *line = index->table[line_num - 1];
+    return SUCCESS_GET_LINE_INFO;
+}
+
+int write_windowed(viewed_file *file, off_t offset, size_t length) {
+    if (length == 0) {
+        return write_to_console("", 0, WITH_NEW_LINE);
+    }
+
+    while (length > 0) {
+        map_window *window = window_map_acquire(file->windows, offset);
+        if (window == NULL) {
+            return ERROR_WRITE;
+        }
+        size_t available;
+        const char *addr = window_data(window, offset, &available);
+        size_t part = (length < available) ? length : available;
+
+        int write_check = write_to_console(addr, part, (part == length) ? WITH_NEW_LINE : WITHOUT_NEW_LINE);
+        window_map_release(file->windows, window);
+        if (write_check == ERROR_WRITE) {
+            return ERROR_WRITE;
+        }
+        offset += part;
+        length -= part;
+    }
+    return SUCCESS_WRITE;
+}
+
+int print_line(viewed_file *file, line_index *index, long long line_num) {
+    line_info line;
+    int get_check = get_line_info(index, line_num, &line);
+    if (get_check == ERROR_GET_LINE_INFO) {
+        return ERROR_PRINT_LINE;
+    }
+
+    int write_check = (file->windows != NULL) ? write_windowed(file, line.offset, line.length)
+        : write_to_console(file->addr + line.offset, line.length, WITH_NEW_LINE);
+    if (write_check == ERROR_WRITE) {
+        return ERROR_PRINT_LINE;
+    }
+
+    return SUCCESS_PRINT_LINE;
+}
+
+void prefetch_lines(viewed_file *file, line_index *index, line_prefetcher *prefetcher) {
+    int count = line_prefetcher_predict(prefetcher, index_length(index));
+    if (file->size == 0) {
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        line_info line;
+        int get_check = get_line_info(index, prefetcher->predicted[i], &line);
+        if (get_check == ERROR_GET_LINE_INFO) {
+            continue;
+        }
+        size_t length = (line.length < PREFETCH_MAX_BYTES) ? line.length : PREFETCH_MAX_BYTES;
+
+        /* both only start readahead, the prompt is not held up by the reads */
+        if (file->windows != NULL) {
+            posix_fadvise(file->fildes, line.offset, length, POSIX_FADV_WILLNEED);
+        } else {
+            off_t begin = line.offset - line.offset % file->policy.page_size;
+            madvise(file->addr + begin, line.offset + length - begin, MADV_WILLNEED);
+        }
+    }
+}
+
+void print_prefetch_info(const line_prefetcher *prefetcher) {
+    fprintf(stderr, "Prefetch: last pattern %s, %lld hits, %lld misses, %lld lines prefetched\n",
+            line_prefetcher_pattern(prefetcher), prefetcher->hits, prefetcher->misses, prefetcher->prefetched);
+}
+
+int print_lines(viewed_file *file, line_index *index, line_prefetcher *prefetcher) {
+    if (index->table == NULL && index->compact == NULL && index->offsets.width == OFFSET_WIDTH_NONE) {
+        return ERROR_PRINT_LINES;
+    }
+
+    long long line_num;
+    while (NOT_STOP_INPUT) {
+        int get_line_num_check = get_line_number(file, index, &line_num);
+
+        if (get_line_num_check == ERROR_GET_LINE_NUMBER) {
+            break;
+        }
+        if (get_line_num_check == INVALID_LINE_NUMBER_INPUT) {
+            continue;
+        }
+        if (get_line_num_check == GET_LINE_NUMBER_TIMEOUT) {
+            print_file(file);
+            break;
+        }
+        int extend_check = extend_index(index, line_num);
+        if (extend_check == ERROR_EXTEND_INDEX) {
+            return ERROR_PRINT_LINES;
+        }
+        long long length = index_length(index);
+        if (line_num < 0 || line_num > length) {
+            fprintf(stderr, "Invalid line number. It has to be in range [0, %lld]\n", length);
+            continue;
+        }
+        if (line_num == STOP_INPUT) {
+            break;
+        }
+
+        line_prefetcher_record(prefetcher, line_num);
+        int print_line_check = print_line(file, index, line_num);
+        if (print_line_check == ERROR_PRINT_LINE) {
+            return ERROR_PRINT_LINES;
+        }
+        prefetch_lines(file, index, prefetcher);
+    }
+    return SUCCESS_PRINT_LINES;
+}
+
+int resolve_queries(line_index *index, line_query *queries, long long queries_length, query_result *results) {
+    long long max_line = 0;
+    for (long long i = 0; i < queries_length; i++) {
+        if (queries[i].last > max_line) {
+            max_line = queries[i].last;
+        }
+    }
+    int extend_check = extend_index(index, max_line);
+    if (extend_check == ERROR_EXTEND_INDEX) {
+        return ERROR_ANSWER_QUERIES;
+    }
+
+    sort_queries(queries, queries_length);
+
+    long long length = index_length(index);
+    for (long long i = 0; i < queries_length; i++) {
+        query_result *result = &results[queries[i].order];
+        result->first = queries[i].first;
+        result->last = queries[i].last;
+        result->first_column = queries[i].first_column;
+        result->last_column = queries[i].last_column;
+        result->valid = FALSE;
+        if (queries[i].first < 1 || queries[i].last > length) {
+            continue;
+        }
+
+        line_info first, last;
+        int first_check = get_line_info(index, queries[i].first, &first);
+        int last_check = get_line_info(index, queries[i].last, &last);
+        if (first_check == ERROR_GET_LINE_INFO || last_check == ERROR_GET_LINE_INFO) {
+            return ERROR_ANSWER_QUERIES;
+        }
+        result->offset = first.offset;
+        result->length = last.offset + last.length - first.offset;
+        result->valid = TRUE;
+    }
+    return SUCCESS_ANSWER_QUERIES;
+}
+
+int read_query_file(const char *query_file, line_query **queries, long long *queries_length) {
+    int query_fildes = STDIN_FILENO;
+    if (strcmp(query_file, STDIN_NAME) != STRING_EQUAL) {
+        query_fildes = open(query_file, O_RDONLY);
+        if (query_fildes == ERROR_OPEN_FILE) {
+            perror("Can't open query file");
+            return ERROR_ANSWER_QUERIES;
+        }
+    }
+
+    *queries = NULL;
+    *queries_length = 0;
+    int read_check = read_queries(query_fildes, queries, queries_length);
+    if (query_fildes != STDIN_FILENO) {
+        close_file(query_fildes);
+    }
+    if (read_check == LINE_QUERY_ERROR) {
+        return ERROR_ANSWER_QUERIES;
+    }
+    return SUCCESS_ANSWER_QUERIES;
+}
+
+int report_column_range(output_buffer *out, const char *format, long long line_num, long long first_column,
+                        long long last_column, long long chars) {
+    int flush_check = output_flush(out);
+    if (flush_check == OUTPUT_ERROR) {
+        return OUTPUT_ERROR;
+    }
+    fprintf(stderr, format, line_num, first_column, last_column, chars);
+    return OUTPUT_SUCCESS;
+}
+
+int output_columns(output_buffer *out, viewed_file *file, line_index *index, const query_result *result) {
+    if (index->utf8 == NULL) {
+        return report_column_range(out, "Column range %lld:%lld-%lld needs the UTF-8 index (-u)\n",
+                                   result->first, result->first_column, result->last_column, 0);
+    }
+
+    off_t slice_offset;
+    size_t slice_length;
+    int slice_check = utf8_index_slice(index->utf8, result->first, file->addr + result->offset, result->length,
+                                       result->first_column, result->last_column, &slice_offset, &slice_length);
+    if (slice_check == UTF8_INDEX_ERROR) {
+        return OUTPUT_ERROR;
+    }
+    if (slice_check == UTF8_INDEX_OUT_OF_RANGE) {
+        return report_column_range(out, "Invalid column range %lld:%lld-%lld. It has to be in range [1, %lld]\n",
+                                   result->first, result->first_column, result->last_column, index->utf8->lines[result->first - 1].chars);
+    }
+
+    int output_check = output_reference(out, file->addr + result->offset + slice_offset, slice_length);
+    if (output_check == OUTPUT_SUCCESS) {
+        output_check = output_append(out, "\n", 1);
+    }
+    return output_check;
+}
+
+int answer_queries(viewed_file *file, line_index *index, const char *query_file) {
+    line_query *queries;
+    long long queries_length;
+    int read_check = read_query_file(query_file, &queries, &queries_length);
+    if (read_check == ERROR_ANSWER_QUERIES) {
+        return ERROR_ANSWER_QUERIES;
+    }
+
+    query_result *results = (query_result *) malloc((queries_length + 1) * sizeof(query_result));
+    if (results == NULL) {
+        perror("Can't answer queries");
+        free(queries);
+        return ERROR_ANSWER_QUERIES;
+    }
+
+    output_buffer *out = (output_buffer *) malloc(sizeof(output_buffer));
+    if (out == NULL) {
+        perror("Can't answer queries");
+        free(results);
+        free(queries);
+        return ERROR_ANSWER_QUERIES;
+    }
+    output_init(out, STDOUT_FILENO);
+
+    int result = resolve_queries(index, queries, queries_length, results);
+    long long length = index_length(index);
+    for (long long i = 0; i < queries_length && result == SUCCESS_ANSWER_QUERIES; i++) {
+        if (results[i].valid == FALSE) {
+            int flush_check = output_flush(out);
+            if (flush_check == OUTPUT_ERROR) {
+                perror("Can't write to console");
+                result = ERROR_ANSWER_QUERIES;
+                break;
+            }
+            fprintf(stderr, "Invalid line range %lld-%lld. It has to be in range [1, %lld]\n",
+                    results[i].first, results[i].last, length);
+            continue;
+        }
+
+        int output_check = (results[i].first_column != LINE_QUERY_NO_COLUMNS) ? output_columns(out, file, index, &results[i])
+            : output_line(out, file, results[i].offset, results[i].length);
+        if (output_check == OUTPUT_ERROR) {
+            perror("Can't write to console");
+            result = ERROR_ANSWER_QUERIES;
+        }
+    }
+    if (result == SUCCESS_ANSWER_QUERIES && output_flush(out) == OUTPUT_ERROR) {
+        perror("Can't write to console");
+        result = ERROR_ANSWER_QUERIES;
+    }
+
+    free(out);
+    free(results);
+    free(queries);
+    return result;
+}
+
+int find_line(line_index *index, off_t offset, long long *line_num, line_info *line) {
+    long long low = 1, high = index_length(index);
+    while (low < high) {
+        long long middle = low + (high - low + 1) / 2;
+        int get_check = get_line_info(index, middle, line);
+        if (get_check == ERROR_GET_LINE_INFO) {
+            return ERROR_SEARCH_FILE;
+        }
+        if (line->offset <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    int get_check = get_line_info(index, low, line);
+    if (get_check == ERROR_GET_LINE_INFO) {
+        return ERROR_SEARCH_FILE;
+    }
+    *line_num = low;
+    return SUCCESS_SEARCH_FILE;
+}
+
+int print_match(viewed_file *file, line_index *index, long long line_num) {
+    char number[LINE_NUMBER_SIZE];
+    int number_length = snprintf(number, LINE_NUMBER_SIZE, "%lld:", line_num);
+    int write_check = write_to_console(number, number_length, WITHOUT_NEW_LINE);
+    if (write_check == ERROR_WRITE) {
+        return ERROR_SEARCH_FILE;
+    }
+
+    int print_line_check = print_line(file, index, line_num);
+    if (print_line_check == ERROR_PRINT_LINE) {
+        return ERROR_SEARCH_FILE;
+    }
+    return SUCCESS_SEARCH_FILE;
+}
+
+int close_output(int out_fildes, const char *output_file) {
+    if (output_file == NULL) {
+        return SUCCESS_EXPORT;
+    }
+    int close_check = close(out_fildes);
+    if (close_check == ERROR_CLOSE_FILE) {
+        perror("Can't close output file");
+        return ERROR_EXPORT;
+    }
+    return SUCCESS_EXPORT;
+}
+
+int open_output(viewed_file *file, const char *output_file, int *out_fildes) {
+    *out_fildes = STDOUT_FILENO;
+    if (output_file != NULL) {
+        *out_fildes = open(output_file, O_WRONLY | O_CREAT, OUTPUT_FILE_MODE);
+        if (*out_fildes == ERROR_OPEN_FILE) {
+            perror("Can't open output file");
+            return ERROR_EXPORT;
+        }
+    }
+
+    struct stat out_stat;
+    int fstat_check = fstat(*out_fildes, &out_stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get output file stat");
+        close_output(*out_fildes, output_file);
+        return ERROR_EXPORT;
+    }
+    if (out_stat.st_dev == file->stat.st_dev && out_stat.st_ino == file->stat.st_ino) {
+        fprintf(stderr, "Can't export lines: Output is the input file\n");
+        close_output(*out_fildes, output_file);
+        return ERROR_EXPORT;
+    }
+
+    if (output_file != NULL && S_ISREG(out_stat.st_mode)) {
+        int truncate_check = ftruncate(*out_fildes, 0);
+        if (truncate_check == ERROR_FTRUNCATE) {
+            perror("Can't truncate output file");
+            close_output(*out_fildes, output_file);
+            return ERROR_EXPORT;
+        }
+    }
+    return SUCCESS_EXPORT;
+}
+
+/*
+ * Copies a whole line range with one dump_file call, so the bytes go
+ * file to file (copy_file_range, which reflinks where the filesystem
+ * can) or file to pipe (splice) without passing through this process.
+ */
+int export_lines(viewed_file *file, line_index *index, line_query *range, const char *output_file, int show_info) {
+    line_query query = *range;
+    query.order = 0;
+    query_result result;
+    int resolve_check = resolve_queries(index, &query, 1, &result);
+    if (resolve_check == ERROR_ANSWER_QUERIES) {
+        return ERROR_EXPORT;
+    }
+    if (result.valid == FALSE) {
+        fprintf(stderr, "Invalid line range %lld-%lld. It has to be in range [1, %lld]\n",
+                result.first, result.last, index_length(index));
+        return ERROR_EXPORT;
+    }
+
+    int out_fildes;
+    int open_check = open_output(file, output_file, &out_fildes);
+    if (open_check == ERROR_EXPORT) {
+        return ERROR_EXPORT;
+    }
+
+    off_t length = result.length;
+    int has_new_line = (result.offset + length < file->size);
+    if (has_new_line == TRUE) {
+        length++;
+    }
+    int dump_check = dump_file(file->fildes, result.offset, length, out_fildes);
+    if (dump_check == DUMP_SUCCESS && has_new_line == FALSE && write(out_fildes, "\n", 1) != 1) {
+        perror("Can't write to output");
+        dump_check = DUMP_ERROR;
+    }
+    int close_check = close_output(out_fildes, output_file);
+    if (dump_check == DUMP_ERROR || close_check == ERROR_EXPORT) {
+        return ERROR_EXPORT;
+    }
+
+    if (show_info == TRUE) {
+        fprintf(stderr, "Export: lines %lld-%lld, %lld bytes\n", result.first, result.last, (long long) length);
+    }
+    return SUCCESS_EXPORT;
+}
+
+int search_file(viewed_file *file, line_index *index, const char *pattern, int show_info) {
+    int extend_check = extend_index(index, WHOLE_FILE);
+    if (extend_check == ERROR_EXTEND_INDEX) {
+        return ERROR_SEARCH_FILE;
+    }
+
+    long long threads = count_index_threads(file->size);
+    search_hits hits;
+    map_policy_scan(index->policy, file->addr, file->size);
+    int search_check = search_text(file->addr, file->size, pattern, strlen(pattern), threads, &hits);
+    map_policy_lookup(index->policy, file->addr, file->size);
+    if (search_check == TEXT_SEARCH_ERROR) {
+        return ERROR_SEARCH_FILE;
+    }
+
+    int result = SUCCESS_SEARCH_FILE;
+    long long matched_lines = 0;
+    off_t line_end = 0;
+    for (long long i = 0; i < hits.length && result == SUCCESS_SEARCH_FILE; i++) {
+        if (matched_lines > 0 && hits.offsets[i] < line_end) {
+            continue;
+        }
+
+        long long line_num;
+        line_info line;
+        result = find_line(index, hits.offsets[i], &line_num, &line);
+        if (result == SUCCESS_SEARCH_FILE) {
+            result = print_match(file, index, line_num);
+        }
+        line_end = line.offset + line.length;
+        matched_lines++;
+    }
+
+    if (show_info == TRUE) {
+        fprintf(stderr, "Search: %s kernel, %lld threads, %lld matching lines\n",
+                text_search_kernel(), threads, matched_lines);
+    }
+    search_hits_destroy(&hits);
+    return result;
+}
+
+void report_utf8_errors(const utf8_index *utf8) {
+    for (long long i = 0; i < utf8->errors_length && i < MAX_REPORTED_ERRORS; i++) {
+        fprintf(stderr, "Invalid UTF-8 in line %lld at byte %lld\n", utf8->errors[i].line, (long long) utf8->errors[i].column + 1);
+    }
+    if (utf8->errors_length > MAX_REPORTED_ERRORS) {
+        fprintf(stderr, "%lld more invalid UTF-8 bytes\n", utf8->errors_length - MAX_REPORTED_ERRORS);
+    }
+}
+
+int build_utf8_index(viewed_file *file, line_index *index, int show_info) {
+    map_counters start_counters, end_counters;
+    read_map_counters(&start_counters);
+
+    long long length = index_length(index);
+    index->utf8 = utf8_index_create(length);
+    if (index->utf8 == NULL) {
+        return ERROR_OPEN_INDEX;
+    }
+    for (long long line_num = 1; line_num <= length; line_num++) {
+        line_info line;
+        int get_check = get_line_info(index, line_num, &line);
+        if (get_check == ERROR_GET_LINE_INFO || utf8_index_add_line(index->utf8, file->addr + line.offset, line.length) == UTF8_INDEX_ERROR) {
+            utf8_index_destroy(index->utf8);
+            index->utf8 = NULL;
+            return ERROR_OPEN_INDEX;
+        }
+    }
+    report_utf8_errors(index->utf8);
+
+    if (show_info == TRUE) {
+        read_map_counters(&end_counters);
+        fprintf(stderr, "UTF-8 index: %s kernel, %lld checkpoints, %lld invalid bytes, %zu bytes, %.1f ms\n",
+                utf8_scan_kernel(), index->utf8->checkpoints_length, index->utf8->errors_length,
+                utf8_index_bytes(index->utf8), (end_counters.time_nsec - start_counters.time_nsec) / NSEC_PER_MSEC);
+    }
+    return SUCCESS_OPEN_INDEX;
+}
+
+int prepare_file(viewer_options *options, viewed_file *file, char *name, size_t window_budget) {
+    file->name = name;
+    file->follow = options->follow;
+    file->spilled = FALSE;
+    file->window_budget = window_budget;
+    file->notify_fildes = NO_NOTIFY;
+
+    int open_check = open_file(file->name, &file->fildes, &file->stat);
+    if (open_check == ERROR_OPEN_FILE) {
+        return ERROR_OPEN_FILE;
+    }
+    file->size = file->stat.st_size;
+    if (is_streamed(file->fildes, &file->stat)) {
+        int spill_check = spill_file(file);
+        if (spill_check == ERROR_SPILL) {
+            close_file(file->fildes);
+            return ERROR_OPEN_FILE;
+        }
+    }
+    file->policy = options->policy;
+    map_policy_init(&file->policy, file->fildes, file->size, options->release, options->lazy);
+    if (file->window_budget != NO_WINDOWS) {
+        file->policy.scan = SCAN_NO_ADVICE;
+        file->policy.huge_pages = FALSE;
+        file->policy.release_indexed = FALSE;
+    }
+
+    int map_check = map_file(file);
+    if (map_check == ERROR_MAP_FILE) {
+        close_file(file->fildes);
+        return ERROR_OPEN_FILE;
+    }
+    return SUCCESS_OPEN_FILE;
+}
+
+int open_member(file_set *set, set_member *member, char *name) {
+    int prepare_check = prepare_file(set->options, &member->file, name, set->window_budget);
+    if (prepare_check == ERROR_OPEN_FILE) {
+        return ERROR_OPEN_SET;
+    }
+    member->state = MEMBER_MAPPED;
+
+    int index_check = open_index(set->options, &member->file, &member->index);
+    if (index_check == ERROR_OPEN_INDEX) {
+        return ERROR_OPEN_SET;
+    }
+    member->state = MEMBER_INDEXED;
+    return SUCCESS_OPEN_SET;
+}
+
+void *index_members(void *arg) {
+    file_set *set = (file_set *) arg;
+
+    while (TRUE) {
+        pthread_mutex_lock(&set->lock);
+        long long next = set->next_member++;
+        pthread_mutex_unlock(&set->lock);
+        if (next >= set->count) {
+            break;
+        }
+        open_member(set, &set->members[next], set->options->file_names[next]);
+    }
+    return NULL;
+}
+
+long long count_pool_threads(long long members) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count == ERROR_SYSCONF || cpu_count < SINGLE_THREAD) {
+        cpu_count = SINGLE_THREAD;
+    }
+    return (members < cpu_count) ? members : cpu_count;
+}
+
+void close_file_set(file_set *set) {
+    for (long long i = 0; i < set->count; i++) {
+        set_member *member = &set->members[i];
+        if (member->state == MEMBER_INDEXED) {
+            close_index(&member->file, &member->index);
+        }
+        if (member->state != MEMBER_CLOSED) {
+            unmap_file(&member->file);
+            close_file(member->file.fildes);
+        }
+    }
+    pthread_mutex_destroy(&set->lock);
+    free(set->members);
+}
+
+int number_members(file_set *set) {
+    set->length = 0;
+    for (long long i = 0; i < set->count; i++) {
+        set_member *member = &set->members[i];
+        if (member->state != MEMBER_INDEXED) {
+            return ERROR_OPEN_SET;
+        }
+
+        member->first_line = set->length + 1;
+        member->length = index_length(&member->index);
+        if (i < set->count - 1 && member->length > 0) {
+            line_info last;
+            int get_check = get_line_info(&member->index, member->length, &last);
+            if (get_check == ERROR_GET_LINE_INFO) {
+                return ERROR_OPEN_SET;
+            }
+            if (last.length == 0) {
+                member->length--;
+            }
+        }
+        set->length += member->length;
+    }
+    return SUCCESS_OPEN_SET;
+}
+
+int open_file_set(viewer_options *options, file_set *set, long long *threads) {
+    set->options = options;
+    set->count = options->file_count;
+    set->next_member = 0;
+    set->window_budget = options->window_budget / set->count;
+    if (options->window_budget != NO_WINDOWS && set->window_budget == NO_WINDOWS) {
+        set->window_budget = MIN_MEMBER_BUDGET;
+    }
+    set->members = (set_member *) calloc(set->count, sizeof(set_member));
+    if (set->members == NULL) {
+        perror("Can't open files");
+        return ERROR_OPEN_SET;
+    }
+    pthread_mutex_init(&set->lock, DEFAULT_ATTR);
+
+    *threads = count_pool_threads(set->count);
+    pthread_t *workers = (pthread_t *) calloc(*threads, sizeof(pthread_t));
+    int *started = (int *) calloc(*threads, sizeof(int));
+    if (workers == NULL || started == NULL) {
+        perror("Can't open files");
+        *threads = SINGLE_THREAD;
+    } else {
+        for (long long i = 1; i < *threads; i++) {
+            int create_check = pthread_create(&workers[i], DEFAULT_ATTR, index_members, set);
+            if (create_check != NO_ERROR) {
+                fprintf(stderr, "Can't create thread: %s\n", strerror(create_check));
+                continue;
+            }
+            started[i] = TRUE;
+        }
+    }
+
+    index_members(set);
+    for (long long i = 1; workers != NULL && started != NULL && i < *threads; i++) {
+        if (started[i] == TRUE) {
+            pthread_join(workers[i], IGNORE_RESULT);
+        }
+    }
+    free(workers);
+    free(started);
+
+    int number_check = number_members(set);
+    if (number_check == ERROR_OPEN_SET) {
+        close_file_set(set);
+        return ERROR_OPEN_SET;
+    }
+    return SUCCESS_OPEN_SET;
+}
+
+set_member *find_member(file_set *set, long long line_num) {
+    long long low = 0, high = set->count - 1;
+    while (low < high) {
+        long long middle = low + (high - low + 1) / 2;
+        if (set->members[middle].first_line <= line_num) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return &set->members[low];
+}
+
+int print_set_file(file_set *set) {
+    for (long long i = 0; i < set->count; i++) {
+        set_member *member = &set->members[i];
+        int dump_check = dump_file(member->file.fildes, FILE_START_POS, member->file.size, STDOUT_FILENO);
+        if (dump_check == DUMP_ERROR) {
+            return ERROR_PRINT_FILE;
+        }
+    }
+
+    int write_check = write_to_console("\n", 1, WITHOUT_NEW_LINE);
+    if (write_check == ERROR_WRITE) {
+        return ERROR_PRINT_FILE;
+    }
+    return SUCCESS_PRINT_FILE;
+}
+
+int print_set_lines(file_set *set) {
+    set_member *first = &set->members[0];
+    long long line_num;
+    while (NOT_STOP_INPUT) {
+        int get_line_num_check = get_line_number(&first->file, &first->index, &line_num);
+
+        if (get_line_num_check == ERROR_GET_LINE_NUMBER) {
+            break;
+        }
+        if (get_line_num_check == INVALID_LINE_NUMBER_INPUT) {
+            continue;
+        }
+        if (get_line_num_check == GET_LINE_NUMBER_TIMEOUT) {
+            print_set_file(set);
+            break;
+        }
+        if (line_num < 0 || line_num > set->length) {
+            fprintf(stderr, "Invalid line number. It has to be in range [0, %lld]\n", set->length);
+            continue;
+        }
+        if (line_num == STOP_INPUT) {
+            break;
+        }
+
+        set_member *member = find_member(set, line_num);
+        int print_line_check = print_line(&member->file, &member->index, line_num - member->first_line + 1);
+        if (print_line_check == ERROR_PRINT_LINE) {
+            return ERROR_PRINT_LINES;
+        }
+    }
+    return SUCCESS_PRINT_LINES;
+}
+
+int output_set_range(output_buffer *out, file_set *set, long long first_line, long long last_line) {
+    while (first_line <= last_line) {
+        set_member *member = find_member(set, first_line);
+        long long member_last = member->first_line + member->length - 1;
+        long long last_in_member = (last_line < member_last) ? last_line : member_last;
+
+        line_info first, last;
+        int first_check = get_line_info(&member->index, first_line - member->first_line + 1, &first);
+        int last_check = get_line_info(&member->index, last_in_member - member->first_line + 1, &last);
+        if (first_check == ERROR_GET_LINE_INFO || last_check == ERROR_GET_LINE_INFO) {
+            return OUTPUT_ERROR;
+        }
+
+        int output_check = output_line(out, &member->file, first.offset, last.offset + last.length - first.offset);
+        if (output_check == OUTPUT_ERROR) {
+            return OUTPUT_ERROR;
+        }
+        first_line = last_in_member + 1;
+    }
+    return OUTPUT_SUCCESS;
+}
+
+int answer_set_queries(file_set *set, const char *query_file) {
+    line_query *queries;
+    long long queries_length;
+    int read_check = read_query_file(query_file, &queries, &queries_length);
+    if (read_check == ERROR_ANSWER_QUERIES) {
+        return ERROR_ANSWER_QUERIES;
+    }
+
+    output_buffer *out = (output_buffer *) malloc(sizeof(output_buffer));
+    if (out == NULL) {
+        perror("Can't answer queries");
+        free(queries);
+        return ERROR_ANSWER_QUERIES;
+    }
+    output_init(out, STDOUT_FILENO);
+
+    int result = SUCCESS_ANSWER_QUERIES;
+    for (long long i = 0; i < queries_length && result == SUCCESS_ANSWER_QUERIES; i++) {
+        if (queries[i].first < 1 || queries[i].last > set->length) {
+            if (output_flush(out) == OUTPUT_ERROR) {
+                perror("Can't write to console");
+                result = ERROR_ANSWER_QUERIES;
+                break;
+            }
+            fprintf(stderr, "Invalid line range %lld-%lld. It has to be in range [1, %lld]\n",
+                    queries[i].first, queries[i].last, set->length);
+            continue;
+        }
+
+        if (queries[i].first_column != LINE_QUERY_NO_COLUMNS) {
+            int report_check = report_column_range(out, "Column range %lld:%lld-%lld needs the UTF-8 index (-u)\n",
+                                                   queries[i].first, queries[i].first_column, queries[i].last_column, 0);
+            if (report_check == OUTPUT_ERROR) {
+                perror("Can't write to console");
+                result = ERROR_ANSWER_QUERIES;
+            }
+            continue;
+        }
+
+        int output_check = output_set_range(out, set, queries[i].first, queries[i].last);
+        if (output_check == OUTPUT_ERROR) {
+            perror("Can't write to console");
+            result = ERROR_ANSWER_QUERIES;
+        }
+    }
+    if (result == SUCCESS_ANSWER_QUERIES && output_flush(out) == OUTPUT_ERROR) {
+        perror("Can't write to console");
+        result = ERROR_ANSWER_QUERIES;
+    }
+
+    free(out);
+    free(queries);
+    return result;
+}
+
+void view_file_set(viewer_options *options) {
+    map_counters start_counters, index_counters;
+    read_map_counters(&start_counters);
+
+    file_set set;
+    long long threads;
+    int open_check = open_file_set(options, &set, &threads);
+    if (open_check == ERROR_OPEN_SET) {
+        return;
+    }
+
+    if (options->show_info == TRUE) {
+        read_map_counters(&index_counters);
+        fprintf(stderr, "Indexing: %lld files on %lld threads, %lld lines, %.1f ms, %ld kB resident\n",
+                set.count, threads, set.length, (index_counters.time_nsec - start_counters.time_nsec) / NSEC_PER_MSEC, index_counters.rss_kb);
+    }
+    if (options->query_file != NULL) {
+        answer_set_queries(&set, options->query_file);
+    } else {
+        print_set_lines(&set);
+    }
+    close_file_set(&set);
+}
+
+int main(int argc, char** argv) {
+    viewer_options options;
+    int parse_check = parse_options(argc, argv, &options);
+    if (parse_check == ERROR_PARSE_OPTIONS) {
+        return 0;
+    }
+
+    if (options.file_count > SINGLE_FILE) {
+        view_file_set(&options);
+        return 0;
+    }
+
+    map_counters start_counters, index_counters, end_counters;
+    read_map_counters(&start_counters);
+
+    viewed_file file;
+    int prepare_check = prepare_file(&options, &file, options.file_name, options.window_budget);
+    if (prepare_check == ERROR_OPEN_FILE) {
+        return 0;
+    }
+    if (file.follow == TRUE) {
+        start_follow(&file);
+    }
+
+    line_index index;
+    line_prefetcher prefetcher;
+    line_prefetcher_init(&prefetcher);
+    int index_check = open_index(&options, &file, &index);
+    if (index_check == SUCCESS_OPEN_INDEX) {
+        if (options.show_info == TRUE) {
+            read_map_counters(&index_counters);
+            print_index_info(&index);
+            print_map_info("Indexing", &file, &start_counters, &index_counters);
+        }
+        if (options.utf8 == TRUE) {
+            build_utf8_index(&file, &index, options.show_info);
+            read_map_counters(&index_counters);
+        }
+        if (options.pattern != NULL) {
+            search_file(&file, &index, options.pattern, options.show_info);
+        } else if (options.export_range.first != NO_EXPORT) {
+            export_lines(&file, &index, &options.export_range, options.output_file, options.show_info);
+        } else if (options.query_file != NULL) {
+            answer_queries(&file, &index, options.query_file);
+        } else {
+            print_lines(&file, &index, &prefetcher);
+        }
+        if (options.show_info == TRUE) {
+            read_map_counters(&end_counters);
+            print_map_info("Lookups", &file, &index_counters, &end_counters);
+            if (prefetcher.hits + prefetcher.misses > 0) {
+                print_prefetch_info(&prefetcher);
+            }
+        }
+        close_index(&file, &index);
+    }
+
+    stop_follow(&file);
+    unmap_file(&file);
+    close_file(file.fildes);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef LAB7_LINE_INFO_H
+#define LAB7_LINE_INFO_H
+
+#include <sys/types.h>
+
+typedef struct line_info {
+    off_t offset;
+    size_t length;
+} line_info;
+
+#endif
@@ -0,0 +1,183 @@
+#include "line_query.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+
+#define ERROR_READ -1
+#define READ_EOF 0
+#define INIT_QUERIES_SIZE 64
+#define INIT_TEXT_SIZE 4096
+#define RANGE_DELIMITER '-'
+#define LIST_DELIMITER ','
+#define COLUMN_DELIMITER ':'
+#define DECIMAL_BASE 10
+#define TRUE 1
+
+static int is_separator(char c) {
+    return isspace((unsigned char) c) || c == LIST_DELIMITER;
+}
+
+static int add_query(line_query **queries, long long *queries_size, long long *queries_length, const line_query *parsed) {
+    if (*queries_length == *queries_size) {
+        line_query *ptr = (line_query *) realloc(*queries, 2 * (*queries_size) * sizeof(line_query));
+        if (ptr == NULL) {
+            perror("Can't add query");
+            return LINE_QUERY_ERROR;
+        }
+        *queries = ptr;
+        (*queries_size) *= 2;
+    }
+
+    line_query *query = &(*queries)[*queries_length];
+    *query = *parsed;
+    query->order = *queries_length;
+    (*queries_length)++;
+    return LINE_QUERY_SUCCESS;
+}
+
+static int parse_number(const char **c, const char *end, long long *number) {
+    if (*c == end || !isdigit((unsigned char) **c)) {
+        return LINE_QUERY_ERROR;
+    }
+
+    long long value = 0;
+    while (*c < end && isdigit((unsigned char) **c)) {
+        int digit = **c - '0';
+        if (value > (LLONG_MAX - digit) / DECIMAL_BASE) {
+            return LINE_QUERY_ERROR;
+        }
+        value = value * DECIMAL_BASE + digit;
+        (*c)++;
+    }
+    *number = value;
+    return LINE_QUERY_SUCCESS;
+}
+
+int parse_queries(const char *text, size_t size, line_query **queries, long long *queries_length) {
+    if (text == NULL || queries == NULL || queries_length == NULL) {
+        fprintf(stderr, "Can't parse queries: Invalid argument(s)\n");
+        return LINE_QUERY_ERROR;
+    }
+
+    long long queries_size = INIT_QUERIES_SIZE;
+    *queries_length = 0;
+    *queries = (line_query *) malloc(queries_size * sizeof(line_query));
+    if (*queries == NULL) {
+        perror("Can't parse queries");
+        return LINE_QUERY_ERROR;
+    }
+
+    const char *c = text, *end = text + size;
+    while (c < end) {
+        if (is_separator(*c)) {
+            c++;
+            continue;
+        }
+
+        const char *token = c;
+        line_query query;
+        query.first_column = LINE_QUERY_NO_COLUMNS;
+        query.last_column = LINE_QUERY_NO_COLUMNS;
+        int parse_check = parse_number(&c, end, &query.first);
+        query.last = query.first;
+        if (parse_check == LINE_QUERY_SUCCESS && c < end && *c == RANGE_DELIMITER) {
+            c++;
+            parse_check = parse_number(&c, end, &query.last);
+        } else if (parse_check == LINE_QUERY_SUCCESS && c < end && *c == COLUMN_DELIMITER) {
+            c++;
+            parse_check = parse_number(&c, end, &query.first_column);
+            query.last_column = query.first_column;
+            if (parse_check == LINE_QUERY_SUCCESS && c < end && *c == RANGE_DELIMITER) {
+                c++;
+                parse_check = parse_number(&c, end, &query.last_column);
+            }
+            if (query.first_column == LINE_QUERY_NO_COLUMNS) {
+                parse_check = LINE_QUERY_ERROR;
+            }
+        }
+        if (parse_check == LINE_QUERY_SUCCESS && c < end && !is_separator(*c)) {
+            parse_check = LINE_QUERY_ERROR;
+        }
+
+        while (c < end && !is_separator(*c)) {
+            c++;
+        }
+        if (parse_check == LINE_QUERY_ERROR || query.last < query.first || query.last_column < query.first_column) {
+            fprintf(stderr, "Invalid query: %.*s\n", (int) (c - token), token);
+            continue;
+        }
+
+        int add_check = add_query(queries, &queries_size, queries_length, &query);
+        if (add_check == LINE_QUERY_ERROR) {
+            free(*queries);
+            *queries = NULL;
+            return LINE_QUERY_ERROR;
+        }
+    }
+
+    return LINE_QUERY_SUCCESS;
+}
+
+int read_queries(int fildes, line_query **queries, long long *queries_length) {
+    size_t text_size = INIT_TEXT_SIZE, text_length = 0;
+    char *text = (char *) malloc(text_size);
+    if (text == NULL) {
+        perror("Can't read queries");
+        return LINE_QUERY_ERROR;
+    }
+
+    while (TRUE) {
+        if (text_length == text_size) {
+            char *ptr = (char *) realloc(text, 2 * text_size);
+            if (ptr == NULL) {
+                perror("Can't read queries");
+                free(text);
+                return LINE_QUERY_ERROR;
+            }
+            text = ptr;
+            text_size *= 2;
+        }
+
+        ssize_t bytes_read = read(fildes, text + text_length, text_size - text_length);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't read queries");
+            free(text);
+            return LINE_QUERY_ERROR;
+        }
+        if (bytes_read == READ_EOF) {
+            break;
+        }
+        text_length += bytes_read;
+    }
+
+    int parse_check = parse_queries(text, text_length, queries, queries_length);
+    free(text);
+    return parse_check;
+}
+
+static int compare_queries(const void *a, const void *b) {
+    const line_query *first = (const line_query *) a;
+    const line_query *second = (const line_query *) b;
+
+    if (first->first != second->first) {
+        return (first->first < second->first) ? -1 : 1;
+    }
+    if (first->order != second->order) {
+        return (first->order < second->order) ? -1 : 1;
+    }
+    return 0;
+}
+
+void sort_queries(line_query *queries, long long queries_length) {
+    if (queries == NULL || queries_length < 2) {
+        return;
+    }
+    qsort(queries, queries_length, sizeof(line_query), compare_queries);
+}
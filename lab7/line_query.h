@@ -0,0 +1,23 @@
+#ifndef LAB7_LINE_QUERY_H
+#define LAB7_LINE_QUERY_H
+
+#include <stddef.h>
+
+#define LINE_QUERY_ERROR -1
+#define LINE_QUERY_SUCCESS 0
+
+#define LINE_QUERY_NO_COLUMNS 0
+
+typedef struct line_query {
+    long long first;
+    long long last;
+    long long first_column;
+    long long last_column;
+    long long order;
+} line_query;
+
+int parse_queries(const char *text, size_t size, line_query **queries, long long *queries_length);
+int read_queries(int fildes, line_query **queries, long long *queries_length);
+void sort_queries(line_query *queries, long long queries_length);
+
+#endif
@@ -0,0 +1,541 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "line_info.h"
+#include "index_cache.h"
+#include "line_query.h"
+#include "map_policy.h"
+#include "offset_index.h"
+
+#define ERROR_OPEN_FILE -1
+#define ERROR_FSTAT -1
+#define ERROR_SOCKET -1
+#define ERROR_BIND -1
+#define ERROR_LISTEN -1
+#define ERROR_ACCEPT -1
+#define ERROR_EPOLL -1
+#define ERROR_READ -1
+#define ERROR_WRITEV -1
+#define ERROR_LOAD_FILE -1
+#define ERROR_ADD_PIECE -1
+#define ERROR_CLIENT -1
+#define ERROR_SERVE -1
+
+#define SUCCESS_LOAD_FILE 0
+#define SUCCESS_ADD_PIECE 0
+#define SUCCESS_CLIENT 0
+#define SUCCESS_SERVE 0
+
+#define MIN_NUM_OF_ARGS 3
+#define SOCKET_ARG 1
+#define FIRST_FILE_ARG 2
+#define TRUE 1
+#define FALSE 0
+#define READ_EOF 0
+#define ANY_ADDRESS 0
+#define FILE_START_POS 0
+#define STRING_EQUAL 0
+#define LISTEN_BACKLOG 1024
+#define MAX_EVENTS 256
+#define NO_TIMEOUT -1
+#define REQUEST_SIZE 4096
+#define INIT_PIECES_SIZE 16
+#define PIECES_HIGH_WATER 4096
+#define WRITE_IOV_MAX 256
+#define HEADER_SIZE 64
+#define FILE_DELIMITER ' '
+#define NEW_LINE '\n'
+
+typedef struct served_file {
+    char *name;
+    int fildes;
+    struct stat stat;
+    char *addr;
+    off_t size;
+    map_policy policy;
+    offset_index index;
+    index_cache cache;
+} served_file;
+
+typedef struct reply_piece {
+    const char *base;
+    size_t length;
+    char *owned;
+} reply_piece;
+
+typedef struct client {
+    int fildes;
+    char input[REQUEST_SIZE];
+    size_t input_length;
+    reply_piece *pieces;
+    size_t pieces_size;
+    size_t pieces_head;
+    size_t pieces_length;
+    int closing;
+    unsigned int events;
+} client;
+
+typedef struct line_server {
+    served_file *files;
+    int files_length;
+    int listen_fildes;
+    int epoll_fildes;
+    long long clients;
+} line_server;
+
+static volatile sig_atomic_t stop_server = FALSE;
+
+void handle_stop(int signal_number) {
+    (void) signal_number;
+    stop_server = TRUE;
+}
+
+int load_file(served_file *file, char *name) {
+    file->name = name;
+    file->addr = NULL;
+    file->index.width = OFFSET_WIDTH_NONE;
+    file->cache.addr = NULL;
+
+    file->fildes = open(name, O_RDONLY);
+    if (file->fildes == ERROR_OPEN_FILE) {
+        perror("Can't open file");
+        return ERROR_LOAD_FILE;
+    }
+    int fstat_check = fstat(file->fildes, &file->stat);
+    if (fstat_check == ERROR_FSTAT) {
+        perror("Can't get file stat");
+        return ERROR_LOAD_FILE;
+    }
+    if (!S_ISREG(file->stat.st_mode)) {
+        fprintf(stderr, "Can't serve %s: Not a regular file\n", name);
+        return ERROR_LOAD_FILE;
+    }
+    file->size = file->stat.st_size;
+    file->policy.scan = SCAN_SEQUENTIAL;
+    map_policy_init(&file->policy, file->fildes, file->size, FALSE, FALSE);
+
+    if (file->size > 0) {
+        file->addr = (char *) mmap(ANY_ADDRESS, file->size, PROT_READ, MAP_SHARED | map_policy_flags(&file->policy), file->fildes, FILE_START_POS);
+        if (file->addr == MAP_FAILED) {
+            file->addr = NULL;
+            perror("Can't map file");
+            return ERROR_LOAD_FILE;
+        }
+    }
+
+    int open_check = offset_index_open(&file->index, &file->cache, name, &file->stat, file->fildes,
+                                       file->addr, NULL, &file->policy, file->size);
+    return (open_check == OFFSET_INDEX_ERROR) ? ERROR_LOAD_FILE : SUCCESS_LOAD_FILE;
+}
+
+void unload_file(served_file *file) {
+    if (file->index.width != OFFSET_WIDTH_NONE) {
+        offset_index_close(&file->index, &file->cache);
+    }
+    if (file->addr != NULL) {
+        munmap(file->addr, file->size);
+    }
+    close(file->fildes);
+}
+
+served_file *find_file(line_server *server, const char *name, size_t name_length) {
+    for (int i = 0; i < server->files_length; i++) {
+        const char *file_name = server->files[i].name;
+        if (strlen(file_name) == name_length && memcmp(file_name, name, name_length) == STRING_EQUAL) {
+            return &server->files[i];
+        }
+    }
+    return NULL;
+}
+
+int add_piece(client *c, const char *base, size_t length, char *owned) {
+    if (c->pieces_head + c->pieces_length == c->pieces_size) {
+        if (c->pieces_head > 0) {
+            memmove(c->pieces, c->pieces + c->pieces_head, c->pieces_length * sizeof(reply_piece));
+            c->pieces_head = 0;
+        } else {
+            size_t size = (c->pieces_size == 0) ? INIT_PIECES_SIZE : 2 * c->pieces_size;
+            reply_piece *ptr = (reply_piece *) realloc(c->pieces, size * sizeof(reply_piece));
+            if (ptr == NULL) {
+                perror("Can't queue reply");
+                free(owned);
+                return ERROR_ADD_PIECE;
+            }
+            c->pieces = ptr;
+            c->pieces_size = size;
+        }
+    }
+
+    reply_piece *piece = &c->pieces[c->pieces_head + c->pieces_length];
+    piece->base = base;
+    piece->length = length;
+    piece->owned = owned;
+    c->pieces_length++;
+    return SUCCESS_ADD_PIECE;
+}
+
+int add_message(client *c, const char *format, long long value, const char *text) {
+    char *message = (char *) malloc(HEADER_SIZE);
+    if (message == NULL) {
+        perror("Can't queue reply");
+        return ERROR_ADD_PIECE;
+    }
+    int length = (text != NULL) ? snprintf(message, HEADER_SIZE, format, text) : snprintf(message, HEADER_SIZE, format, value);
+    if (length >= HEADER_SIZE) {
+        length = HEADER_SIZE - 1;
+        message[length - 1] = NEW_LINE;
+    }
+    return add_piece(c, message, length, message);
+}
+
+int add_range(client *c, served_file *file, const line_query *query) {
+    line_info first, last;
+    offset_index_get(&file->index, query->first - 1, &first);
+    offset_index_get(&file->index, query->last - 1, &last);
+    off_t end = last.offset + last.length;
+
+    if (end < file->size) {
+        return add_piece(c, file->addr + first.offset, end + 1 - first.offset, NULL);
+    }
+    if (end > first.offset) {
+        int add_check = add_piece(c, file->addr + first.offset, end - first.offset, NULL);
+        if (add_check == ERROR_ADD_PIECE) {
+            return ERROR_ADD_PIECE;
+        }
+    }
+    return add_piece(c, "\n", 1, NULL);
+}
+
+int answer_request(line_server *server, client *c, const char *request, size_t length) {
+    const char *delimiter = (const char *) memchr(request, FILE_DELIMITER, length);
+    size_t name_length = (delimiter == NULL) ? length : (size_t) (delimiter - request);
+    served_file *file = find_file(server, request, name_length);
+    if (file == NULL) {
+        return add_message(c, "ERR %s\n", 0, "unknown file");
+    }
+
+    line_query *queries = NULL;
+    long long queries_length = 0;
+    size_t rest = (delimiter == NULL) ? 0 : length - name_length - 1;
+    int parse_check = parse_queries(request + length - rest, rest, &queries, &queries_length);
+    if (parse_check == LINE_QUERY_ERROR) {
+        return add_message(c, "ERR %s\n", 0, "can't parse request");
+    }
+
+    long long lines = 0;
+    for (long long i = 0; i < queries_length; i++) {
+        if (queries[i].first < 1 || queries[i].last > file->index.length) {
+            free(queries);
+            return add_message(c, "ERR line range has to be in [1, %lld]\n", file->index.length, NULL);
+        }
+        if (queries[i].first_column != LINE_QUERY_NO_COLUMNS) {
+            free(queries);
+            return add_message(c, "ERR %s\n", 0, "column ranges aren't served");
+        }
+        lines += queries[i].last - queries[i].first + 1;
+    }
+
+    int add_check = add_message(c, "OK %lld\n", lines, NULL);
+    for (long long i = 0; i < queries_length && add_check == SUCCESS_ADD_PIECE; i++) {
+        add_check = add_range(c, file, &queries[i]);
+    }
+    free(queries);
+    return add_check;
+}
+
+int flush_client(client *c) {
+    while (c->pieces_length > 0) {
+        struct iovec iov[WRITE_IOV_MAX];
+        int iov_count = 0;
+        while (iov_count < WRITE_IOV_MAX && (size_t) iov_count < c->pieces_length) {
+            reply_piece *piece = &c->pieces[c->pieces_head + iov_count];
+            iov[iov_count].iov_base = (void *) piece->base;
+            iov[iov_count].iov_len = piece->length;
+            iov_count++;
+        }
+
+        ssize_t written = writev(c->fildes, iov, iov_count);
+        if (written == ERROR_WRITEV) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return SUCCESS_CLIENT;
+            }
+            return ERROR_CLIENT;
+        }
+
+        while (c->pieces_length > 0 && (size_t) written >= c->pieces[c->pieces_head].length) {
+            reply_piece *piece = &c->pieces[c->pieces_head];
+            written -= piece->length;
+            free(piece->owned);
+            c->pieces_head++;
+            c->pieces_length--;
+        }
+        if (c->pieces_length > 0) {
+            c->pieces[c->pieces_head].base += written;
+            c->pieces[c->pieces_head].length -= written;
+        }
+    }
+    c->pieces_head = 0;
+    return SUCCESS_CLIENT;
+}
+
+int read_requests(line_server *server, client *c) {
+    while (c->closing == FALSE && c->pieces_length < PIECES_HIGH_WATER) {
+        ssize_t bytes_read = read(c->fildes, c->input + c->input_length, REQUEST_SIZE - c->input_length);
+        if (bytes_read == ERROR_READ) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return ERROR_CLIENT;
+        }
+        if (bytes_read == READ_EOF) {
+            c->closing = TRUE;
+            break;
+        }
+        c->input_length += bytes_read;
+
+        size_t begin = 0;
+        char *new_line;
+        while ((new_line = (char *) memchr(c->input + begin, NEW_LINE, c->input_length - begin)) != NULL) {
+            size_t end = new_line - c->input;
+            int answer_check = answer_request(server, c, c->input + begin, end - begin);
+            if (answer_check == ERROR_ADD_PIECE) {
+                return ERROR_CLIENT;
+            }
+            begin = end + 1;
+        }
+        c->input_length -= begin;
+        memmove(c->input, c->input + begin, c->input_length);
+
+        if (c->input_length == REQUEST_SIZE) {
+            add_message(c, "ERR %s\n", 0, "request is too long");
+            c->closing = TRUE;
+        }
+    }
+    return SUCCESS_CLIENT;
+}
+
+void close_client(line_server *server, client *c) {
+    epoll_ctl(server->epoll_fildes, EPOLL_CTL_DEL, c->fildes, NULL);
+    close(c->fildes);
+    for (size_t i = 0; i < c->pieces_length; i++) {
+        free(c->pieces[c->pieces_head + i].owned);
+    }
+    free(c->pieces);
+    free(c);
+    server->clients--;
+}
+
+int update_events(line_server *server, client *c) {
+    unsigned int events = 0;
+    if (c->closing == FALSE && c->pieces_length < PIECES_HIGH_WATER) {
+        events |= EPOLLIN;
+    }
+    if (c->pieces_length > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == c->events) {
+        return SUCCESS_CLIENT;
+    }
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = c;
+    int ctl_check = epoll_ctl(server->epoll_fildes, EPOLL_CTL_MOD, c->fildes, &event);
+    if (ctl_check == ERROR_EPOLL) {
+        perror("Can't update client events");
+        return ERROR_CLIENT;
+    }
+    c->events = events;
+    return SUCCESS_CLIENT;
+}
+
+void serve_client(line_server *server, client *c, unsigned int events) {
+    int result = SUCCESS_CLIENT;
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        result = read_requests(server, c);
+    }
+    if (result == SUCCESS_CLIENT) {
+        result = flush_client(c);
+    }
+    if (result == SUCCESS_CLIENT && c->closing == TRUE && c->pieces_length == 0) {
+        result = ERROR_CLIENT;
+    }
+    if (result == SUCCESS_CLIENT) {
+        result = update_events(server, c);
+    }
+    if (result == ERROR_CLIENT) {
+        close_client(server, c);
+    }
+}
+
+void accept_clients(line_server *server) {
+    while (TRUE) {
+        int fildes = accept4(server->listen_fildes, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fildes == ERROR_ACCEPT) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Can't accept client");
+            }
+            return;
+        }
+
+        client *c = (client *) calloc(1, sizeof(client));
+        if (c == NULL) {
+            perror("Can't accept client");
+            close(fildes);
+            continue;
+        }
+        c->fildes = fildes;
+        c->events = EPOLLIN;
+
+        struct epoll_event event;
+        event.events = c->events;
+        event.data.ptr = c;
+        int ctl_check = epoll_ctl(server->epoll_fildes, EPOLL_CTL_ADD, fildes, &event);
+        if (ctl_check == ERROR_EPOLL) {
+            perror("Can't watch client");
+            close(fildes);
+            free(c);
+            continue;
+        }
+        server->clients++;
+    }
+}
+
+int open_socket(const char *path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Can't create socket: Path is too long\n");
+        return ERROR_SOCKET;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fildes = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fildes == ERROR_SOCKET) {
+        perror("Can't create socket");
+        return ERROR_SOCKET;
+    }
+
+    unlink(path);
+    int bind_check = bind(fildes, (struct sockaddr *) &address, sizeof(address));
+    if (bind_check == ERROR_BIND) {
+        perror("Can't bind socket");
+        close(fildes);
+        return ERROR_SOCKET;
+    }
+    int listen_check = listen(fildes, LISTEN_BACKLOG);
+    if (listen_check == ERROR_LISTEN) {
+        perror("Can't listen on socket");
+        close(fildes);
+        unlink(path);
+        return ERROR_SOCKET;
+    }
+    return fildes;
+}
+
+int run_server(line_server *server) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    int ctl_check = epoll_ctl(server->epoll_fildes, EPOLL_CTL_ADD, server->listen_fildes, &event);
+    if (ctl_check == ERROR_EPOLL) {
+        perror("Can't watch socket");
+        return ERROR_SERVE;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (stop_server == FALSE) {
+        int ready = epoll_wait(server->epoll_fildes, events, MAX_EVENTS, NO_TIMEOUT);
+        if (ready == ERROR_EPOLL) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Can't wait for clients");
+            return ERROR_SERVE;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_clients(server);
+            } else {
+                serve_client(server, (client *) events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+    return SUCCESS_SERVE;
+}
+
+int main(int argc, char **argv) {
+    if (argc < MIN_NUM_OF_ARGS) {
+        printf("Usage: %s <socket> <filename>...\n", argv[0]);
+        return 0;
+    }
+
+    line_server server;
+    server.files_length = 0;
+    server.clients = 0;
+    server.files = (served_file *) malloc((argc - FIRST_FILE_ARG) * sizeof(served_file));
+    if (server.files == NULL) {
+        perror("Can't start server");
+        return 0;
+    }
+    for (int i = FIRST_FILE_ARG; i < argc; i++) {
+        int load_check = load_file(&server.files[server.files_length], argv[i]);
+        if (load_check == ERROR_LOAD_FILE) {
+            unload_file(&server.files[server.files_length]);
+            continue;
+        }
+        server.files_length++;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server.listen_fildes = open_socket(argv[SOCKET_ARG]);
+    server.epoll_fildes = epoll_create1(EPOLL_CLOEXEC);
+    if (server.epoll_fildes == ERROR_EPOLL) {
+        perror("Can't create epoll instance");
+    }
+    if (server.files_length > 0 && server.listen_fildes != ERROR_SOCKET && server.epoll_fildes != ERROR_EPOLL) {
+        run_server(&server);
+    }
+
+    if (server.listen_fildes != ERROR_SOCKET) {
+        close(server.listen_fildes);
+        unlink(argv[SOCKET_ARG]);
+    }
+    if (server.epoll_fildes != ERROR_EPOLL) {
+        close(server.epoll_fildes);
+    }
+    for (int i = 0; i < server.files_length; i++) {
+        unload_file(&server.files[i]);
+    }
+    free(server.files);
+    return 0;
+}
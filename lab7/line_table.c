@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+#include "line_table.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define ERROR_PREAD -1
+#define ERROR_MUNMAP -1
+#define ERROR_SYSCONF -1
+#define DEFAULT_PAGE_SIZE 4096
+#define ANY_ADDRESS 0
+#define NO_FILDES -1
+#define TABLE_PROTECTION (PROT_READ | PROT_WRITE)
+#define TABLE_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE)
+#define HEADER_SIZE 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define SAMPLE_COUNT 8
+#define SAMPLE_SIZE (64 * 1024)
+#define ESTIMATE_MARGIN 4
+#define NEW_LINE '\n'
+#define TRUE 1
+
+typedef struct line_table_header {
+    size_t map_size;
+} line_table_header;
+
+static size_t mapping_size(long long table_size, size_t entry_size) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size == ERROR_SYSCONF) {
+        page_size = DEFAULT_PAGE_SIZE;
+    }
+    size_t size = HEADER_SIZE + table_size * entry_size;
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+static void *table_start(char *addr, size_t map_size) {
+    ((line_table_header *) addr)->map_size = map_size;
+    if (map_size >= HUGE_PAGE_SIZE) {
+        madvise(addr, map_size, MADV_HUGEPAGE);
+    }
+    return addr + HEADER_SIZE;
+}
+
+static char *table_mapping(void *table) {
+    return (char *) table - HEADER_SIZE;
+}
+
+void *line_table_create_entries(long long table_size, size_t entry_size) {
+    size_t map_size = mapping_size(table_size, entry_size);
+    char *addr = (char *) mmap(ANY_ADDRESS, map_size, TABLE_PROTECTION, TABLE_FLAGS, NO_FILDES, 0);
+    if (addr == MAP_FAILED) {
+        perror("Can't create table");
+        return NULL;
+    }
+    return table_start(addr, map_size);
+}
+
+void *line_table_grow_entries(void *table, long long table_size, size_t entry_size) {
+    char *addr = table_mapping(table);
+    size_t old_size = ((line_table_header *) addr)->map_size;
+    size_t map_size = mapping_size(table_size, entry_size);
+    if (map_size <= old_size) {
+        return table;
+    }
+
+    char *new_addr = (char *) mremap(addr, old_size, map_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED) {
+        perror("Can't grow table");
+        return NULL;
+    }
+    return table_start(new_addr, map_size);
+}
+
+line_info *line_table_create(long long table_size) {
+    return (line_info *) line_table_create_entries(table_size, sizeof(line_info));
+}
+
+line_info *line_table_grow(line_info *table, long long table_size) {
+    return (line_info *) line_table_grow_entries(table, table_size, sizeof(line_info));
+}
+
+void line_table_free(void *table) {
+    if (table == NULL) {
+        return;
+    }
+    char *addr = table_mapping(table);
+    int munmap_check = munmap(addr, ((line_table_header *) addr)->map_size);
+    if (munmap_check == ERROR_MUNMAP) {
+        perror("Can't free table");
+    }
+}
+
+static ssize_t read_sample(int fildes, char *buf, size_t size, off_t offset) {
+    while (TRUE) {
+        ssize_t bytes_read = pread(fildes, buf, size, offset);
+        if (bytes_read == ERROR_PREAD && errno == EINTR) {
+            continue;
+        }
+        return bytes_read;
+    }
+}
+
+long long estimate_line_count(int fildes, off_t file_size) {
+    char *sample = (char *) malloc(SAMPLE_SIZE);
+    if (sample == NULL || file_size <= 0) {
+        free(sample);
+        return LINE_TABLE_MIN_SIZE;
+    }
+
+    long long new_lines = 0;
+    off_t sampled = 0;
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        off_t offset = file_size / SAMPLE_COUNT * i;
+        ssize_t bytes_read = read_sample(fildes, sample, SAMPLE_SIZE, offset);
+        if (bytes_read <= 0) {
+            break;
+        }
+        for (const char *c = sample, *end = sample + bytes_read;
+                (c = (const char *) memchr(c, NEW_LINE, end - c)) != NULL; c++) {
+            new_lines++;
+        }
+        sampled += bytes_read;
+    }
+    free(sample);
+
+    if (sampled == 0) {
+        return LINE_TABLE_MIN_SIZE;
+    }
+    long long estimate = (long long) ((double) file_size * new_lines / sampled) + 1;
+    estimate += estimate / ESTIMATE_MARGIN;
+    return (estimate < LINE_TABLE_MIN_SIZE) ? LINE_TABLE_MIN_SIZE : estimate;
+}
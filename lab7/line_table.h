@@ -0,0 +1,17 @@
+#ifndef LAB7_LINE_TABLE_H
+#define LAB7_LINE_TABLE_H
+
+#include <sys/types.h>
+#include <stddef.h>
+#include "line_info.h"
+
+#define LINE_TABLE_MIN_SIZE 100
+
+void *line_table_create_entries(long long table_size, size_t entry_size);
+void *line_table_grow_entries(void *table, long long table_size, size_t entry_size);
+line_info *line_table_create(long long table_size);
+line_info *line_table_grow(line_info *table, long long table_size);
+void line_table_free(void *table);
+long long estimate_line_count(int fildes, off_t file_size);
+
+#endif
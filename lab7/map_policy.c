@@ -0,0 +1,158 @@
+#include "map_policy.h"
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ERROR_MADVISE -1
+#define ERROR_FSTATFS -1
+#define ERROR_SYSCONF -1
+#define STRING_EQUAL 0
+#define TRUE 1
+#define FALSE 0
+#define TMPFS_MAGIC 0x01021994
+#define DEFAULT_PAGE_SIZE 4096
+#define KB 1024
+#define NSEC_PER_SEC 1000000000LL
+#define MEMINFO_LINE_SIZE 256
+#define MEMINFO_PATH "/proc/meminfo"
+#define STATM_PATH "/proc/self/statm"
+#define MEM_AVAILABLE_FORMAT "MemAvailable: %ld kB"
+#define UNKNOWN_MEMORY -1
+
+static const char *policy_names[] = {"none", "sequential", "populate"};
+
+int parse_map_policy(const char *name, map_policy *policy) {
+    for (int i = SCAN_NO_ADVICE; i <= SCAN_POPULATE; i++) {
+        if (strcmp(name, policy_names[i]) == STRING_EQUAL) {
+            policy->scan = (scan_advice) i;
+            return MAP_POLICY_SUCCESS;
+        }
+    }
+    fprintf(stderr, "Unknown mapping policy %s, expected none, sequential or populate\n", name);
+    return MAP_POLICY_ERROR;
+}
+
+static long available_memory_kb() {
+    FILE *meminfo = fopen(MEMINFO_PATH, "r");
+    if (meminfo == NULL) {
+        return UNKNOWN_MEMORY;
+    }
+
+    char line[MEMINFO_LINE_SIZE];
+    long available = UNKNOWN_MEMORY;
+    while (fgets(line, MEMINFO_LINE_SIZE, meminfo) != NULL) {
+        if (sscanf(line, MEM_AVAILABLE_FORMAT, &available) == 1) {
+            break;
+        }
+    }
+    fclose(meminfo);
+    return available;
+}
+
+void map_policy_init(map_policy *policy, int fildes, off_t file_size, int force_release, int lazy) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    policy->page_size = (page_size == ERROR_SYSCONF) ? DEFAULT_PAGE_SIZE : page_size;
+    policy->released = 0;
+    if (lazy == TRUE && policy->scan == SCAN_POPULATE) {
+        policy->scan = SCAN_SEQUENTIAL;
+    }
+
+    struct statfs fs_stat;
+    int fstatfs_check = fstatfs(fildes, &fs_stat);
+    policy->huge_pages = (fstatfs_check != ERROR_FSTATFS && fs_stat.f_type == TMPFS_MAGIC);
+
+    long available = available_memory_kb();
+    policy->release_indexed = force_release
+        || (available != UNKNOWN_MEMORY && file_size / KB > available);
+}
+
+const char *map_policy_name(const map_policy *policy) {
+    return policy_names[policy->scan];
+}
+
+int map_policy_flags(const map_policy *policy) {
+    return (policy->scan == SCAN_POPULATE) ? MAP_POPULATE : 0;
+}
+
+static void advise(char *addr, size_t length, int advice) {
+    if (addr == NULL || length == 0) {
+        return;
+    }
+    int madvise_check = madvise(addr, length, advice);
+    if (madvise_check == ERROR_MADVISE) {
+        perror("Can't advise kernel about mapping");
+    }
+}
+
+void map_policy_scan(map_policy *policy, char *file_addr, off_t file_size) {
+    if (policy->huge_pages == TRUE) {
+        advise(file_addr, file_size, MADV_HUGEPAGE);
+    }
+    if (policy->scan != SCAN_NO_ADVICE) {
+        advise(file_addr, file_size, MADV_SEQUENTIAL);
+    }
+}
+
+void map_policy_indexed(map_policy *policy, char *file_addr, off_t indexed) {
+    if (policy->release_indexed == FALSE) {
+        return;
+    }
+
+    off_t end = indexed - indexed % policy->page_size;
+    if (end > policy->released) {
+        advise(file_addr + policy->released, end - policy->released, MADV_DONTNEED);
+        policy->released = end;
+    }
+}
+
+/*
+ * Drops the whole pages inside [begin, end). Unlike map_policy_indexed it
+ * keeps no state, so scan threads can each release their own chunk.
+ */
+void map_policy_release(const map_policy *policy, char *file_addr, off_t begin, off_t end) {
+    if (policy == NULL || policy->release_indexed == FALSE) {
+        return;
+    }
+
+    off_t first_page = (begin + policy->page_size - 1) / policy->page_size * policy->page_size;
+    off_t last_page = end - end % policy->page_size;
+    if (last_page > first_page) {
+        advise(file_addr + first_page, last_page - first_page, MADV_DONTNEED);
+    }
+}
+
+void map_policy_lookup(map_policy *policy, char *file_addr, off_t file_size) {
+    if (policy->scan != SCAN_NO_ADVICE) {
+        advise(file_addr, file_size, MADV_RANDOM);
+    }
+}
+
+void map_policy_reset(map_policy *policy) {
+    policy->released = 0;
+}
+
+void read_map_counters(map_counters *counters) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counters->time_nsec = now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    counters->minor_faults = usage.ru_minflt;
+    counters->major_faults = usage.ru_majflt;
+    counters->rss_kb = 0;
+
+    FILE *statm = fopen(STATM_PATH, "r");
+    if (statm == NULL) {
+        return;
+    }
+    long size, resident;
+    if (fscanf(statm, "%ld %ld", &size, &resident) == 2) {
+        counters->rss_kb = resident * (long) (sysconf(_SC_PAGESIZE) / KB);
+    }
+    fclose(statm);
+}
@@ -0,0 +1,45 @@
+#ifndef LAB7_MAP_POLICY_H
+#define LAB7_MAP_POLICY_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+#define MAP_POLICY_ERROR -1
+#define MAP_POLICY_SUCCESS 0
+
+#define MAP_POLICY_RELEASE_STEP (8 * 1024 * 1024)
+
+typedef enum scan_advice {
+    SCAN_NO_ADVICE,
+    SCAN_SEQUENTIAL,
+    SCAN_POPULATE
+} scan_advice;
+
+typedef struct map_policy {
+    scan_advice scan;
+    int huge_pages;
+    int release_indexed;
+    size_t page_size;
+    off_t released;
+} map_policy;
+
+typedef struct map_counters {
+    long minor_faults;
+    long major_faults;
+    long rss_kb;
+    long long time_nsec;
+} map_counters;
+
+int parse_map_policy(const char *name, map_policy *policy);
+void map_policy_init(map_policy *policy, int fildes, off_t file_size, int force_release, int lazy);
+const char *map_policy_name(const map_policy *policy);
+int map_policy_flags(const map_policy *policy);
+void map_policy_scan(map_policy *policy, char *file_addr, off_t file_size);
+void map_policy_indexed(map_policy *policy, char *file_addr, off_t indexed);
+void map_policy_release(const map_policy *policy, char *file_addr, off_t begin, off_t end);
+void map_policy_lookup(map_policy *policy, char *file_addr, off_t file_size);
+void map_policy_reset(map_policy *policy);
+
+void read_map_counters(map_counters *counters);
+
+#endif
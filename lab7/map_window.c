@@ -0,0 +1,151 @@
+#include "map_window.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define ERROR_SYSCONF -1
+#define ERROR_MUNMAP -1
+#define DEFAULT_PAGE_SIZE 4096
+#define DEFAULT_ATTR NULL
+#define ANY_ADDRESS 0
+#define TRUE 1
+#define FALSE 0
+
+static void unmap_window(map_window *window) {
+    int munmap_check = munmap(window->addr, window->length);
+    if (munmap_check == ERROR_MUNMAP) {
+        perror("Can't unmap file window");
+    }
+    window->addr = NULL;
+    window->length = 0;
+}
+
+window_map *window_map_create(int fildes, off_t file_size, size_t budget) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size == ERROR_SYSCONF) {
+        page_size = DEFAULT_PAGE_SIZE;
+    }
+
+    size_t window_size = budget / MAP_WINDOW_MIN_COUNT;
+    if (window_size > MAP_WINDOW_SIZE) {
+        window_size = MAP_WINDOW_SIZE;
+    }
+    window_size -= window_size % page_size;
+    if (window_size < (size_t) page_size) {
+        window_size = page_size;
+    }
+
+    long long window_count = budget / window_size;
+    long long needed = (file_size + window_size - 1) / window_size;
+    if (window_count > needed) {
+        window_count = needed;
+    }
+    if (window_count < MAP_WINDOW_MIN_COUNT) {
+        window_count = MAP_WINDOW_MIN_COUNT;
+    }
+
+    window_map *map = (window_map *) calloc(1, sizeof(window_map));
+    map_window *windows = (map_window *) calloc(window_count, sizeof(map_window));
+    if (map == NULL || windows == NULL) {
+        perror("Can't create file windows");
+        free(map);
+        free(windows);
+        return NULL;
+    }
+
+    map->fildes = fildes;
+    map->file_size = file_size;
+    map->window_size = window_size;
+    map->window_count = window_count;
+    map->windows = windows;
+    pthread_mutex_init(&map->lock, DEFAULT_ATTR);
+    pthread_cond_init(&map->released, DEFAULT_ATTR);
+    return map;
+}
+
+static map_window *find_slot(window_map *map, off_t window_offset, int *mapped) {
+    map_window *unused = NULL, *oldest = NULL;
+    for (int i = 0; i < map->window_count; i++) {
+        map_window *window = &map->windows[i];
+        if (window->addr != NULL && window->offset == window_offset) {
+            *mapped = TRUE;
+            return window;
+        }
+        if (window->addr == NULL) {
+            if (unused == NULL) {
+                unused = window;
+            }
+        } else if (window->users == 0 && (oldest == NULL || window->last_use < oldest->last_use)) {
+            oldest = window;
+        }
+    }
+    return (unused != NULL) ? unused : oldest;
+}
+
+map_window *window_map_acquire(window_map *map, off_t offset) {
+    if (map == NULL || offset < 0 || offset >= map->file_size) {
+        fprintf(stderr, "Can't get file window: Invalid argument(s)\n");
+        return NULL;
+    }
+    off_t window_offset = offset - offset % map->window_size;
+
+    pthread_mutex_lock(&map->lock);
+    map_window *window;
+    int mapped = FALSE;
+    while ((window = find_slot(map, window_offset, &mapped)) == NULL) {
+        pthread_cond_wait(&map->released, &map->lock);
+    }
+
+    if (mapped != TRUE) {
+        if (window->addr != NULL) {
+            unmap_window(window);
+        }
+        size_t length = map->window_size;
+        if ((off_t) length > map->file_size - window_offset) {
+            length = map->file_size - window_offset;
+        }
+        char *addr = (char *) mmap(ANY_ADDRESS, length, PROT_READ, MAP_SHARED, map->fildes, window_offset);
+        if (addr == MAP_FAILED) {
+            perror("Can't map file window");
+            pthread_mutex_unlock(&map->lock);
+            return NULL;
+        }
+        window->addr = addr;
+        window->offset = window_offset;
+        window->length = length;
+        map->mappings++;
+    }
+
+    window->users++;
+    window->last_use = ++map->clock;
+    pthread_mutex_unlock(&map->lock);
+    return window;
+}
+
+void window_map_release(window_map *map, map_window *window) {
+    pthread_mutex_lock(&map->lock);
+    window->users--;
+    pthread_cond_signal(&map->released);
+    pthread_mutex_unlock(&map->lock);
+}
+
+const char *window_data(const map_window *window, off_t offset, size_t *available) {
+    *available = window->offset + window->length - offset;
+    return window->addr + (offset - window->offset);
+}
+
+void window_map_destroy(window_map *map) {
+    if (map == NULL) {
+        return;
+    }
+    for (int i = 0; i < map->window_count; i++) {
+        if (map->windows[i].addr != NULL) {
+            unmap_window(&map->windows[i]);
+        }
+    }
+    pthread_cond_destroy(&map->released);
+    pthread_mutex_destroy(&map->lock);
+    free(map->windows);
+    free(map);
+}
@@ -0,0 +1,40 @@
+#ifndef LAB7_MAP_WINDOW_H
+#define LAB7_MAP_WINDOW_H
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#define MAP_WINDOW_ERROR -1
+#define MAP_WINDOW_SUCCESS 0
+
+#define MAP_WINDOW_SIZE (64 * 1024 * 1024)
+#define MAP_WINDOW_MIN_COUNT 2
+
+typedef struct map_window {
+    char *addr;
+    off_t offset;
+    size_t length;
+    int users;
+    unsigned long long last_use;
+} map_window;
+
+typedef struct window_map {
+    int fildes;
+    off_t file_size;
+    size_t window_size;
+    int window_count;
+    map_window *windows;
+    unsigned long long clock;
+    long long mappings;
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+} window_map;
+
+window_map *window_map_create(int fildes, off_t file_size, size_t budget);
+map_window *window_map_acquire(window_map *map, off_t offset);
+void window_map_release(window_map *map, map_window *window);
+const char *window_data(const map_window *window, off_t offset, size_t *available);
+void window_map_destroy(window_map *map);
+
+#endif
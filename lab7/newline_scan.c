@@ -0,0 +1,162 @@
+#include "newline_scan.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define BLOCK_SIZE 64
+#define NEW_LINE '\n'
+
+typedef size_t (*scan_function)(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned);
+
+static size_t scan_generic_from(const char *addr, size_t size, size_t start, off_t *positions, size_t max_positions, size_t found, size_t *scanned) {
+    const char *c = addr + start;
+    const char *end = addr + size;
+
+    while (found < max_positions && c < end) {
+        const char *new_line = (const char *) memchr(c, NEW_LINE, end - c);
+        if (new_line == NULL) {
+            break;
+        }
+        positions[found++] = new_line - addr;
+        c = new_line + 1;
+    }
+
+    if (found == max_positions && found > 0) {
+        *scanned = positions[found - 1] + 1;
+    } else {
+        *scanned = size;
+    }
+    return found;
+}
+
+static size_t scan_generic(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned) {
+    return scan_generic_from(addr, size, 0, positions, max_positions, 0, scanned);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+static inline size_t emit_mask(uint64_t mask, size_t block, off_t *positions, size_t max_positions, size_t found) {
+    while (mask != 0 && found < max_positions) {
+        positions[found++] = block + __builtin_ctzll(mask);
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned) {
+    const __m128i new_line = _mm_set1_epi8(NEW_LINE);
+    size_t block = 0, found = 0;
+
+    for (; block + BLOCK_SIZE <= size; block += BLOCK_SIZE) {
+        const __m128i *p = (const __m128i *) (addr + block);
+        uint64_t m0 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p), new_line));
+        uint64_t m1 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 1), new_line));
+        uint64_t m2 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), new_line));
+        uint64_t m3 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 3), new_line));
+        uint64_t mask = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+        if (mask == 0) {
+            continue;
+        }
+
+        found = emit_mask(mask, block, positions, max_positions, found);
+        if (found == max_positions) {
+            *scanned = positions[found - 1] + 1;
+            return found;
+        }
+    }
+
+    return scan_generic_from(addr, size, block, positions, max_positions, found, scanned);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned) {
+    const __m256i new_line = _mm256_set1_epi8(NEW_LINE);
+    size_t block = 0, found = 0;
+
+    for (; block + BLOCK_SIZE <= size; block += BLOCK_SIZE) {
+        const __m256i *p = (const __m256i *) (addr + block);
+        uint64_t low = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p), new_line));
+        uint64_t high = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), new_line));
+        uint64_t mask = low | (high << 32);
+        if (mask == 0) {
+            continue;
+        }
+
+        found = emit_mask(mask, block, positions, max_positions, found);
+        if (found == max_positions) {
+            *scanned = positions[found - 1] + 1;
+            return found;
+        }
+    }
+
+    return scan_generic_from(addr, size, block, positions, max_positions, found, scanned);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_avx512(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned) {
+    const __m512i new_line = _mm512_set1_epi8(NEW_LINE);
+    size_t block = 0, found = 0;
+
+    for (; block + BLOCK_SIZE <= size; block += BLOCK_SIZE) {
+        uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *) (addr + block)), new_line);
+        if (mask == 0) {
+            continue;
+        }
+
+        found = emit_mask(mask, block, positions, max_positions, found);
+        if (found == max_positions) {
+            *scanned = positions[found - 1] + 1;
+            return found;
+        }
+    }
+
+    return scan_generic_from(addr, size, block, positions, max_positions, found, scanned);
+}
+
+#endif
+
+static scan_function selected_scan = NULL;
+static const char *selected_name = NULL;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static void select_kernel() {
+    scan_function scan = scan_generic;
+    const char *name = "generic";
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        scan = scan_avx512;
+        name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        scan = scan_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan = scan_sse2;
+        name = "sse2";
+    }
+#endif
+
+    selected_name = name;
+    selected_scan = scan;
+}
+
+size_t scan_newlines(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned) {
+    pthread_once(&select_once, select_kernel);
+    if (max_positions == 0) {
+        *scanned = 0;
+        return 0;
+    }
+    return selected_scan(addr, size, positions, max_positions, scanned);
+}
+
+const char *newline_scan_kernel() {
+    pthread_once(&select_once, select_kernel);
+    return selected_name;
+}
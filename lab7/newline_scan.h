@@ -0,0 +1,10 @@
+#ifndef LAB7_NEWLINE_SCAN_H
+#define LAB7_NEWLINE_SCAN_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+size_t scan_newlines(const char *addr, size_t size, off_t *positions, size_t max_positions, size_t *scanned);
+const char *newline_scan_kernel();
+
+#endif
@@ -0,0 +1,111 @@
+#include "offset_index.h"
+#include "line_table.h"
+#include <unistd.h>
+#include <stdint.h>
+
+#define ERROR_SYSCONF -1
+#define SINGLE_THREAD 1
+
+long long count_index_threads(off_t file_size) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count == ERROR_SYSCONF || cpu_count < SINGLE_THREAD) {
+        cpu_count = SINGLE_THREAD;
+    }
+
+    long long threads = file_size / OFFSET_INDEX_MIN_CHUNK_SIZE;
+    if (threads > cpu_count) {
+        threads = cpu_count;
+    }
+    if (threads < SINGLE_THREAD) {
+        threads = SINGLE_THREAD;
+    }
+    return threads;
+}
+
+static long long count_table_threads(off_t file_size, window_map *windows) {
+    long long threads = count_index_threads(file_size);
+    if (windows != NULL && threads > windows->window_count) {
+        threads = windows->window_count;
+    }
+    return threads;
+}
+
+static size_t entry_size(const offset_index *index) {
+    return (index->width == OFFSET_WIDTH_32) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+int offset_index_open(offset_index *index, index_cache *cache, const char *name, const struct stat *file_stat, int fildes,
+                      char *file_addr, window_map *windows, map_policy *policy, off_t file_size) {
+    index->width = offset_table_width(file_size);
+    index->length = 0;
+
+    if (name != NULL) {
+        void *offsets = load_index_cache(name, file_stat, entry_size(index), &index->length, cache);
+        if (offsets != NULL) {
+            if (index->width == OFFSET_WIDTH_32) {
+                offset_table32_attach(&index->offsets32, offsets, index->length, file_size);
+            } else {
+                offset_table64_attach(&index->offsets64, offsets, index->length, file_size);
+            }
+            map_policy_lookup(policy, file_addr, file_size);
+            return OFFSET_INDEX_SUCCESS;
+        }
+    }
+
+    map_policy_scan(policy, file_addr, file_size);
+    long long expected_length = estimate_line_count(fildes, file_size);
+    long long threads = count_table_threads(file_size, windows);
+    int build_check;
+    void *offsets;
+    if (index->width == OFFSET_WIDTH_32) {
+        build_check = offset_table32_build(&index->offsets32, file_addr, windows, policy, file_size, expected_length, threads);
+        index->length = index->offsets32.length;
+        offsets = index->offsets32.offsets;
+    } else {
+        build_check = offset_table64_build(&index->offsets64, file_addr, windows, policy, file_size, expected_length, threads);
+        index->length = index->offsets64.length;
+        offsets = index->offsets64.offsets;
+    }
+    if (build_check == OFFSET_TABLE_ERROR) {
+        index->width = OFFSET_WIDTH_NONE;
+        index->length = 0;
+        return OFFSET_INDEX_ERROR;
+    }
+
+    map_policy_indexed(policy, file_addr, file_size);
+    map_policy_lookup(policy, file_addr, file_size);
+    if (name != NULL) {
+        save_index_cache(name, file_stat, offsets, entry_size(index), index->length);
+    }
+    return OFFSET_INDEX_SUCCESS;
+}
+
+void offset_index_get(const offset_index *index, long long position, line_info *line) {
+    if (index->width == OFFSET_WIDTH_32) {
+        offset_table32_get(&index->offsets32, position, line);
+    } else {
+        offset_table64_get(&index->offsets64, position, line);
+    }
+}
+
+size_t offset_index_bytes(const offset_index *index) {
+    if (index->width == OFFSET_WIDTH_32) {
+        return offset_table32_bytes(&index->offsets32);
+    }
+    if (index->width == OFFSET_WIDTH_64) {
+        return offset_table64_bytes(&index->offsets64);
+    }
+    return 0;
+}
+
+void offset_index_close(offset_index *index, index_cache *cache) {
+    if (cache->addr != NULL) {
+        close_index_cache(cache);
+    } else if (index->width == OFFSET_WIDTH_32) {
+        offset_table32_free(&index->offsets32);
+    } else if (index->width == OFFSET_WIDTH_64) {
+        offset_table64_free(&index->offsets64);
+    }
+    index->width = OFFSET_WIDTH_NONE;
+    index->length = 0;
+}
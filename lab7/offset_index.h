@@ -0,0 +1,40 @@
+#ifndef LAB7_OFFSET_INDEX_H
+#define LAB7_OFFSET_INDEX_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include "line_info.h"
+#include "index_cache.h"
+#include "map_policy.h"
+#include "map_window.h"
+#include "offset_table.h"
+
+#define OFFSET_INDEX_ERROR -1
+#define OFFSET_INDEX_SUCCESS 0
+
+#define OFFSET_INDEX_MIN_CHUNK_SIZE (16 * 1024 * 1024)
+
+/*
+ * Whole-file line index shared by lab7 and line_server: the offset table
+ * of the width the file size needs, loaded from the sidecar cache when it
+ * is current and otherwise built in parallel chunks and saved back. A
+ * NULL name skips the cache (spilled streams have no file to name it by).
+ * The cache mapping, if any, lives in the caller's index_cache so a
+ * caller can share it with other kinds of index.
+ */
+typedef struct offset_index {
+    int width;
+    offset_table32 offsets32;
+    offset_table64 offsets64;
+    long long length;
+} offset_index;
+
+long long count_index_threads(off_t file_size);
+int offset_index_open(offset_index *index, index_cache *cache, const char *name, const struct stat *file_stat, int fildes,
+                      char *file_addr, window_map *windows, map_policy *policy, off_t file_size);
+void offset_index_get(const offset_index *index, long long position, line_info *line);
+size_t offset_index_bytes(const offset_index *index);
+void offset_index_close(offset_index *index, index_cache *cache);
+
+#endif
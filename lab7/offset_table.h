@@ -0,0 +1,248 @@
+#ifndef LAB7_OFFSET_TABLE_H
+#define LAB7_OFFSET_TABLE_H
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "line_info.h"
+#include "line_table.h"
+#include "map_window.h"
+#include "map_policy.h"
+#include "newline_scan.h"
+
+#define OFFSET_TABLE_ERROR -1
+#define OFFSET_TABLE_SUCCESS 0
+
+#define OFFSET_WIDTH_NONE 0
+#define OFFSET_WIDTH_32 32
+#define OFFSET_WIDTH_64 64
+
+#define OFFSET_TABLE_BATCH_SIZE 4096
+#define OFFSET_TABLE_INIT_SIZE 100
+
+/*
+ * Line index that stores only the offset where each line starts, the
+ * length being implied by the next start (or by the file size for the
+ * last line). DEFINE_OFFSET_TABLE(name, offset_type) instantiates the
+ * table type and all of its functions for one offset width, so the scan
+ * and lookup loops are compiled separately for every width instead of
+ * going through a run-time switch.
+ */
+
+static inline int offset_table_width(off_t file_size) {
+    return ((uint64_t) file_size <= UINT32_MAX) ? OFFSET_WIDTH_32 : OFFSET_WIDTH_64;
+}
+
+#define DEFINE_OFFSET_TABLE(name, offset_type)                                                          \
+                                                                                                        \
+typedef struct name {                                                                                   \
+    offset_type *offsets;                                                                               \
+    long long length;                                                                                   \
+    long long size;                                                                                     \
+    off_t file_size;                                                                                    \
+} name;                                                                                                 \
+                                                                                                        \
+typedef struct name##_chunk {                                                                           \
+    name table;                                                                                         \
+    const char *file_addr;                                                                              \
+    window_map *windows;                                                                                \
+    const map_policy *policy;                                                                           \
+    off_t begin;                                                                                        \
+    off_t end;                                                                                          \
+    int status;                                                                                         \
+} name##_chunk;                                                                                         \
+                                                                                                        \
+static inline int name##_init(name *table, long long size, off_t file_size) {                           \
+    table->length = 0;                                                                                  \
+    table->size = (size < OFFSET_TABLE_INIT_SIZE) ? OFFSET_TABLE_INIT_SIZE : size;                      \
+    table->file_size = file_size;                                                                       \
+    table->offsets = (offset_type *) line_table_create_entries(table->size, sizeof(offset_type));       \
+    return (table->offsets == NULL) ? OFFSET_TABLE_ERROR : OFFSET_TABLE_SUCCESS;                        \
+}                                                                                                       \
+                                                                                                        \
+static inline void name##_attach(name *table, void *offsets, long long length, off_t file_size) {       \
+    table->offsets = (offset_type *) offsets;                                                           \
+    table->length = length;                                                                             \
+    table->size = 0;                                                                                    \
+    table->file_size = file_size;                                                                       \
+}                                                                                                       \
+                                                                                                        \
+static inline void name##_free(name *table) {                                                           \
+    if (table->size != 0) {                                                                             \
+        line_table_free(table->offsets);                                                                \
+    }                                                                                                   \
+    table->offsets = NULL;                                                                              \
+    table->length = 0;                                                                                  \
+    table->size = 0;                                                                                    \
+}                                                                                                       \
+                                                                                                        \
+static inline int name##_reserve(name *table, long long required) {                                     \
+    long long size = table->size;                                                                       \
+    while (size < required) {                                                                           \
+        size *= 2;                                                                                      \
+    }                                                                                                   \
+    if (size == table->size) {                                                                          \
+        return OFFSET_TABLE_SUCCESS;                                                                    \
+    }                                                                                                   \
+    offset_type *offsets = (offset_type *) line_table_grow_entries(table->offsets, size, sizeof(offset_type)); \
+    if (offsets == NULL) {                                                                              \
+        return OFFSET_TABLE_ERROR;                                                                      \
+    }                                                                                                   \
+    table->offsets = offsets;                                                                           \
+    table->size = size;                                                                                 \
+    return OFFSET_TABLE_SUCCESS;                                                                        \
+}                                                                                                       \
+                                                                                                        \
+static inline int name##_fill(name *table, const char *addr, off_t begin, off_t end) {                  \
+    off_t new_lines[OFFSET_TABLE_BATCH_SIZE];                                                           \
+    off_t file_offset = begin;                                                                          \
+                                                                                                        \
+    while (file_offset < end) {                                                                         \
+        size_t scanned = 0;                                                                             \
+        size_t found = scan_newlines(addr + (file_offset - begin), end - file_offset,                   \
+                                     new_lines, OFFSET_TABLE_BATCH_SIZE, &scanned);                     \
+        if (name##_reserve(table, table->length + found) == OFFSET_TABLE_ERROR) {                       \
+            return OFFSET_TABLE_ERROR;                                                                  \
+        }                                                                                               \
+        offset_type *elem = table->offsets + table->length;                                             \
+        for (size_t i = 0; i < found; i++) {                                                            \
+            elem[i] = (offset_type) (file_offset + new_lines[i] + 1);                                   \
+        }                                                                                               \
+        table->length += found;                                                                         \
+        file_offset += scanned;                                                                         \
+    }                                                                                                   \
+    return OFFSET_TABLE_SUCCESS;                                                                        \
+}                                                                                                       \
+                                                                                                        \
+static inline int name##_fill_range(name *table, const char *file_addr, window_map *windows,            \
+                                    const map_policy *policy, off_t begin, off_t end) {                 \
+    if (windows == NULL) {                                                                              \
+        while (begin < end) {                                                                           \
+            off_t step = (end - begin < MAP_POLICY_RELEASE_STEP) ? end - begin : MAP_POLICY_RELEASE_STEP; \
+            if (name##_fill(table, file_addr + begin, begin, begin + step) == OFFSET_TABLE_ERROR) {     \
+                return OFFSET_TABLE_ERROR;                                                              \
+            }                                                                                           \
+            map_policy_release(policy, (char *) file_addr, begin, begin + step);                        \
+            begin += step;                                                                              \
+        }                                                                                               \
+        return OFFSET_TABLE_SUCCESS;                                                                    \
+    }                                                                                                   \
+    while (begin < end) {                                                                               \
+        map_window *window = window_map_acquire(windows, begin);                                        \
+        if (window == NULL) {                                                                           \
+            return OFFSET_TABLE_ERROR;                                                                  \
+        }                                                                                               \
+        size_t available;                                                                               \
+        const char *addr = window_data(window, begin, &available);                                      \
+        off_t block_end = (begin + (off_t) available < end) ? begin + (off_t) available : end;          \
+        int fill_check = name##_fill(table, addr, begin, block_end);                                    \
+        window_map_release(windows, window);                                                            \
+        if (fill_check == OFFSET_TABLE_ERROR) {                                                         \
+            return OFFSET_TABLE_ERROR;                                                                  \
+        }                                                                                               \
+        begin = block_end;                                                                              \
+    }                                                                                                   \
+    return OFFSET_TABLE_SUCCESS;                                                                        \
+}                                                                                                       \
+                                                                                                        \
+static inline void *name##_fill_chunk(void *arg) {                                                      \
+    name##_chunk *chunk = (name##_chunk *) arg;                                                         \
+    chunk->status = name##_fill_range(&chunk->table, chunk->file_addr, chunk->windows, chunk->policy,   \
+                                      chunk->begin, chunk->end);                                        \
+    return NULL;                                                                                        \
+}                                                                                                       \
+                                                                                                        \
+static inline int name##_merge(name *table, name##_chunk *chunks, long long chunk_count) {              \
+    long long total_length = 0;                                                                         \
+    for (long long i = 0; i < chunk_count; i++) {                                                       \
+        if (chunks[i].status == OFFSET_TABLE_ERROR) {                                                   \
+            return OFFSET_TABLE_ERROR;                                                                  \
+        }                                                                                               \
+        total_length += chunks[i].table.length;                                                         \
+    }                                                                                                   \
+    *table = chunks[0].table;                                                                           \
+    chunks[0].table.size = 0;                                                                           \
+    if (name##_reserve(table, total_length) == OFFSET_TABLE_ERROR) {                                    \
+        name##_free(table);                                                                             \
+        return OFFSET_TABLE_ERROR;                                                                      \
+    }                                                                                                   \
+    for (long long i = 1; i < chunk_count; i++) {                                                       \
+        memcpy(table->offsets + table->length, chunks[i].table.offsets,                                 \
+               chunks[i].table.length * sizeof(offset_type));                                           \
+        table->length += chunks[i].table.length;                                                        \
+    }                                                                                                   \
+    return OFFSET_TABLE_SUCCESS;                                                                        \
+}                                                                                                       \
+                                                                                                        \
+static inline int name##_build(name *table, const char *file_addr, window_map *windows,                 \
+                               const map_policy *policy, off_t file_size,                               \
+                               long long expected_length, long long threads) {                          \
+    name##_chunk *chunks = (name##_chunk *) calloc(threads, sizeof(name##_chunk));                      \
+    pthread_t *thread_ids = (pthread_t *) calloc(threads, sizeof(pthread_t));                           \
+    int *started = (int *) calloc(threads, sizeof(int));                                                \
+    if (chunks == NULL || thread_ids == NULL || started == NULL) {                                      \
+        perror("Can't create table");                                                                   \
+        free(chunks);                                                                                   \
+        free(thread_ids);                                                                               \
+        free(started);                                                                                  \
+        return OFFSET_TABLE_ERROR;                                                                      \
+    }                                                                                                   \
+                                                                                                        \
+    int result = OFFSET_TABLE_SUCCESS;                                                                  \
+    off_t chunk_size = file_size / threads;                                                             \
+    for (long long i = 0; i < threads && result == OFFSET_TABLE_SUCCESS; i++) {                         \
+        chunks[i].file_addr = file_addr;                                                                \
+        chunks[i].windows = windows;                                                                    \
+        chunks[i].policy = policy;                                                                      \
+        chunks[i].begin = i * chunk_size;                                                               \
+        chunks[i].end = (i == threads - 1) ? file_size : (i + 1) * chunk_size;                          \
+        result = name##_init(&chunks[i].table, expected_length / threads, file_size);                   \
+    }                                                                                                   \
+                                                                                                        \
+    if (result == OFFSET_TABLE_SUCCESS) {                                                               \
+        chunks[0].table.offsets[chunks[0].table.length++] = 0;                                          \
+        for (long long i = 1; i < threads; i++) {                                                       \
+            int create_check = pthread_create(&thread_ids[i], NULL, name##_fill_chunk, &chunks[i]);     \
+            if (create_check != 0) {                                                                    \
+                fprintf(stderr, "Can't create thread: %s\n", strerror(create_check));                   \
+                continue;                                                                               \
+            }                                                                                           \
+            started[i] = 1;                                                                             \
+        }                                                                                               \
+        name##_fill_chunk(&chunks[0]);                                                                  \
+        for (long long i = 1; i < threads; i++) {                                                       \
+            if (started[i] == 1) {                                                                      \
+                pthread_join(thread_ids[i], NULL);                                                      \
+            } else {                                                                                    \
+                name##_fill_chunk(&chunks[i]);                                                          \
+            }                                                                                           \
+        }                                                                                               \
+        result = name##_merge(table, chunks, threads);                                                  \
+    }                                                                                                   \
+                                                                                                        \
+    for (long long i = 0; i < threads; i++) {                                                           \
+        name##_free(&chunks[i].table);                                                                  \
+    }                                                                                                   \
+    free(chunks);                                                                                       \
+    free(thread_ids);                                                                                   \
+    free(started);                                                                                      \
+    return result;                                                                                      \
+}                                                                                                       \
+                                                                                                        \
+static inline void name##_get(const name *table, long long position, line_info *line) {                 \
+    off_t end = (position + 1 < table->length) ? (off_t) table->offsets[position + 1] - 1 : table->file_size; \
+    line->offset = (off_t) table->offsets[position];                                                    \
+    line->length = end - line->offset;                                                                  \
+}                                                                                                       \
+                                                                                                        \
+static inline size_t name##_bytes(const name *table) {                                                  \
+    return table->length * sizeof(offset_type);                                                         \
+}
+
+DEFINE_OFFSET_TABLE(offset_table32, uint32_t)
+DEFINE_OFFSET_TABLE(offset_table64, uint64_t)
+
+#endif
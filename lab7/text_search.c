@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+#include "text_search.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define INIT_HITS_SIZE 64
+#define SINGLE_THREAD 1
+#define NO_ERROR 0
+#define TRUE 1
+#define FALSE 0
+#define DEFAULT_ATTR NULL
+#define IGNORE_RESULT NULL
+#define STRING_EQUAL 0
+#define SSE2_BLOCK_SIZE 16
+#define AVX2_BLOCK_SIZE 32
+#define AVX512_BLOCK_SIZE 64
+#define NEW_LINE '\n'
+
+typedef const char *(*find_function)(const char *addr, size_t size, const char *pattern, size_t length);
+
+typedef struct search_chunk {
+    const char *addr;
+    off_t begin;
+    off_t end;
+    off_t size;
+    const char *pattern;
+    size_t pattern_length;
+    search_hits hits;
+    int status;
+} search_chunk;
+
+static const char *find_generic(const char *addr, size_t size, const char *pattern, size_t length) {
+    return (const char *) memmem(addr, size, pattern, length);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+static inline const char *check_candidates(const char *addr, size_t block, uint64_t mask, const char *pattern, size_t length) {
+    size_t middle = (length > 2) ? length - 2 : 0;
+    while (mask != 0) {
+        size_t position = block + __builtin_ctzll(mask);
+        if (memcmp(addr + position + 1, pattern + 1, middle) == STRING_EQUAL) {
+            return addr + position;
+        }
+        mask &= mask - 1;
+    }
+    return NULL;
+}
+
+__attribute__((target("sse2")))
+static const char *find_sse2(const char *addr, size_t size, const char *pattern, size_t length) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[length - 1]);
+    size_t block = 0;
+
+    for (; block + SSE2_BLOCK_SIZE + length - 1 <= size; block += SSE2_BLOCK_SIZE) {
+        __m128i first_block = _mm_loadu_si128((const __m128i *) (addr + block));
+        __m128i last_block = _mm_loadu_si128((const __m128i *) (addr + block + length - 1));
+        uint64_t mask = (uint16_t) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first_block, first), _mm_cmpeq_epi8(last_block, last)));
+        const char *match = check_candidates(addr, block, mask, pattern, length);
+        if (match != NULL) {
+            return match;
+        }
+    }
+
+    return find_generic(addr + block, size - block, pattern, length);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *addr, size_t size, const char *pattern, size_t length) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[length - 1]);
+    size_t block = 0;
+
+    for (; block + AVX2_BLOCK_SIZE + length - 1 <= size; block += AVX2_BLOCK_SIZE) {
+        __m256i first_block = _mm256_loadu_si256((const __m256i *) (addr + block));
+        __m256i last_block = _mm256_loadu_si256((const __m256i *) (addr + block + length - 1));
+        uint64_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first_block, first), _mm256_cmpeq_epi8(last_block, last)));
+        const char *match = check_candidates(addr, block, mask, pattern, length);
+        if (match != NULL) {
+            return match;
+        }
+    }
+
+    return find_generic(addr + block, size - block, pattern, length);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static const char *find_avx512(const char *addr, size_t size, const char *pattern, size_t length) {
+    const __m512i first = _mm512_set1_epi8(pattern[0]);
+    const __m512i last = _mm512_set1_epi8(pattern[length - 1]);
+    size_t block = 0;
+
+    for (; block + AVX512_BLOCK_SIZE + length - 1 <= size; block += AVX512_BLOCK_SIZE) {
+        __m512i first_block = _mm512_loadu_si512((const void *) (addr + block));
+        __m512i last_block = _mm512_loadu_si512((const void *) (addr + block + length - 1));
+        uint64_t mask = _mm512_cmpeq_epi8_mask(first_block, first) & _mm512_cmpeq_epi8_mask(last_block, last);
+        const char *match = check_candidates(addr, block, mask, pattern, length);
+        if (match != NULL) {
+            return match;
+        }
+    }
+
+    return find_generic(addr + block, size - block, pattern, length);
+}
+
+#endif
+
+static find_function selected_find = NULL;
+static const char *selected_name = NULL;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static void select_kernel() {
+    find_function find = find_generic;
+    const char *name = "generic";
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        find = find_avx512;
+        name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        find = find_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        find = find_sse2;
+        name = "sse2";
+    }
+#endif
+
+    selected_name = name;
+    selected_find = find;
+}
+
+static int add_hit(search_hits *hits, off_t offset) {
+    if (hits->length == hits->size) {
+        long long new_size = (hits->size == 0) ? INIT_HITS_SIZE : 2 * hits->size;
+        off_t *ptr = (off_t *) realloc(hits->offsets, new_size * sizeof(off_t));
+        if (ptr == NULL) {
+            perror("Can't store search results");
+            return TEXT_SEARCH_ERROR;
+        }
+        hits->offsets = ptr;
+        hits->size = new_size;
+    }
+    hits->offsets[hits->length++] = offset;
+    return TEXT_SEARCH_SUCCESS;
+}
+
+static void *search_chunk_range(void *arg) {
+    search_chunk *chunk = (search_chunk *) arg;
+
+    off_t region_end = chunk->end + (off_t) chunk->pattern_length - 1;
+    if (region_end > chunk->size) {
+        region_end = chunk->size;
+    }
+
+    off_t offset = chunk->begin;
+    chunk->status = TEXT_SEARCH_SUCCESS;
+    while (offset + (off_t) chunk->pattern_length <= region_end) {
+        const char *match = selected_find(chunk->addr + offset, region_end - offset, chunk->pattern, chunk->pattern_length);
+        if (match == NULL) {
+            break;
+        }
+        off_t match_offset = match - chunk->addr;
+        if (add_hit(&chunk->hits, match_offset) == TEXT_SEARCH_ERROR) {
+            chunk->status = TEXT_SEARCH_ERROR;
+            break;
+        }
+        const char *new_line = (const char *) memchr(match, NEW_LINE, region_end - match_offset);
+        if (new_line == NULL) {
+            break;
+        }
+        offset = new_line - chunk->addr + 1;
+    }
+    return NULL;
+}
+
+static int merge_hits(search_chunk *chunks, long long chunk_count, search_hits *hits) {
+    long long total_length = 0;
+    for (long long i = 0; i < chunk_count; i++) {
+        if (chunks[i].status == TEXT_SEARCH_ERROR) {
+            return TEXT_SEARCH_ERROR;
+        }
+        total_length += chunks[i].hits.length;
+    }
+
+    hits->offsets = (off_t *) malloc((total_length + 1) * sizeof(off_t));
+    if (hits->offsets == NULL) {
+        perror("Can't store search results");
+        return TEXT_SEARCH_ERROR;
+    }
+    hits->size = total_length + 1;
+    for (long long i = 0; i < chunk_count; i++) {
+        memcpy(hits->offsets + hits->length, chunks[i].hits.offsets, chunks[i].hits.length * sizeof(off_t));
+        hits->length += chunks[i].hits.length;
+    }
+    return TEXT_SEARCH_SUCCESS;
+}
+
+int search_text(const char *addr, off_t size, const char *pattern, size_t pattern_length, long long threads, search_hits *hits) {
+    hits->offsets = NULL;
+    hits->length = 0;
+    hits->size = 0;
+    if (pattern == NULL || pattern_length == 0) {
+        fprintf(stderr, "Can't search file: Invalid argument(s)\n");
+        return TEXT_SEARCH_ERROR;
+    }
+    pthread_once(&select_once, select_kernel);
+
+    if (threads < SINGLE_THREAD) {
+        threads = SINGLE_THREAD;
+    }
+    search_chunk *chunks = (search_chunk *) calloc(threads, sizeof(search_chunk));
+    pthread_t *thread_ids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    int *started = (int *) calloc(threads, sizeof(int));
+    if (chunks == NULL || thread_ids == NULL || started == NULL) {
+        perror("Can't search file");
+        free(chunks);
+        free(thread_ids);
+        free(started);
+        return TEXT_SEARCH_ERROR;
+    }
+
+    off_t chunk_size = size / threads;
+    for (long long i = 0; i < threads; i++) {
+        chunks[i].addr = addr;
+        chunks[i].begin = i * chunk_size;
+        chunks[i].end = (i == threads - 1) ? size : (i + 1) * chunk_size;
+        chunks[i].size = size;
+        chunks[i].pattern = pattern;
+        chunks[i].pattern_length = pattern_length;
+    }
+
+    for (long long i = 1; i < threads; i++) {
+        int create_check = pthread_create(&thread_ids[i], DEFAULT_ATTR, search_chunk_range, &chunks[i]);
+        if (create_check != NO_ERROR) {
+            fprintf(stderr, "Can't create thread: %s\n", strerror(create_check));
+            continue;
+        }
+        started[i] = TRUE;
+    }
+
+    search_chunk_range(&chunks[0]);
+    for (long long i = 1; i < threads; i++) {
+        if (started[i] == TRUE) {
+            pthread_join(thread_ids[i], IGNORE_RESULT);
+        } else {
+            search_chunk_range(&chunks[i]);
+        }
+    }
+
+    int result = merge_hits(chunks, threads, hits);
+    for (long long i = 0; i < threads; i++) {
+        free(chunks[i].hits.offsets);
+    }
+    free(chunks);
+    free(thread_ids);
+    free(started);
+    if (result == TEXT_SEARCH_ERROR) {
+        search_hits_destroy(hits);
+    }
+    return result;
+}
+
+void search_hits_destroy(search_hits *hits) {
+    free(hits->offsets);
+    hits->offsets = NULL;
+    hits->length = 0;
+    hits->size = 0;
+}
+
+const char *text_search_kernel() {
+    pthread_once(&select_once, select_kernel);
+    return selected_name;
+}
@@ -0,0 +1,20 @@
+#ifndef LAB7_TEXT_SEARCH_H
+#define LAB7_TEXT_SEARCH_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+#define TEXT_SEARCH_ERROR -1
+#define TEXT_SEARCH_SUCCESS 0
+
+typedef struct search_hits {
+    off_t *offsets;
+    long long length;
+    long long size;
+} search_hits;
+
+int search_text(const char *addr, off_t size, const char *pattern, size_t pattern_length, long long threads, search_hits *hits);
+void search_hits_destroy(search_hits *hits);
+const char *text_search_kernel();
+
+#endif
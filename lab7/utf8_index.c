@@ -0,0 +1,321 @@
+#include "utf8_index.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define INIT_CHECKPOINTS_SIZE 64
+#define INIT_ERRORS_SIZE 16
+#define MIN_LINES_SIZE 100
+#define INVALID_SEQUENCE 0
+#define ASCII_MASK 0x8080808080808080ULL
+#define WORD_SIZE 8
+#define SSE2_BLOCK_SIZE 16
+#define AVX2_BLOCK_SIZE 32
+#define AVX512_BLOCK_SIZE 64
+
+typedef size_t (*ascii_function)(const unsigned char *addr, size_t size);
+
+static size_t ascii_generic(const unsigned char *addr, size_t size) {
+    size_t i = 0;
+    for (; i + WORD_SIZE <= size; i += WORD_SIZE) {
+        uint64_t word;
+        memcpy(&word, addr + i, WORD_SIZE);
+        if ((word & ASCII_MASK) != 0) {
+            break;
+        }
+    }
+    while (i < size && addr[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static size_t ascii_sse2(const unsigned char *addr, size_t size) {
+    size_t block = 0;
+    for (; block + SSE2_BLOCK_SIZE <= size; block += SSE2_BLOCK_SIZE) {
+        uint32_t mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (addr + block)));
+        if (mask != 0) {
+            return block + __builtin_ctz(mask);
+        }
+    }
+    return block + ascii_generic(addr + block, size - block);
+}
+
+__attribute__((target("avx2")))
+static size_t ascii_avx2(const unsigned char *addr, size_t size) {
+    size_t block = 0;
+    for (; block + AVX2_BLOCK_SIZE <= size; block += AVX2_BLOCK_SIZE) {
+        uint32_t mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *) (addr + block)));
+        if (mask != 0) {
+            return block + __builtin_ctz(mask);
+        }
+    }
+    return block + ascii_generic(addr + block, size - block);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t ascii_avx512(const unsigned char *addr, size_t size) {
+    size_t block = 0;
+    for (; block + AVX512_BLOCK_SIZE <= size; block += AVX512_BLOCK_SIZE) {
+        uint64_t mask = _mm512_movepi8_mask(_mm512_loadu_si512((const void *) (addr + block)));
+        if (mask != 0) {
+            return block + __builtin_ctzll(mask);
+        }
+    }
+    return block + ascii_generic(addr + block, size - block);
+}
+
+#endif
+
+static ascii_function selected_ascii = NULL;
+static const char *selected_name = NULL;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static void select_kernel() {
+    ascii_function ascii = ascii_generic;
+    const char *name = "generic";
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        ascii = ascii_avx512;
+        name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        ascii = ascii_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        ascii = ascii_sse2;
+        name = "sse2";
+    }
+#endif
+
+    selected_name = name;
+    selected_ascii = ascii;
+}
+
+static int is_continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+/*
+ * Length of the well-formed sequence starting at c (RFC 3629: no overlong
+ * forms, no surrogates, nothing above U+10FFFF), or INVALID_SEQUENCE.
+ */
+static size_t sequence_length(const unsigned char *c, size_t available) {
+    unsigned char lead = c[0];
+    if (lead < 0x80) {
+        return 1;
+    }
+
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) {
+            low = 0xA0;
+        } else if (lead == 0xED) {
+            high = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) {
+            low = 0x90;
+        } else if (lead == 0xF4) {
+            high = 0x8F;
+        }
+    } else {
+        return INVALID_SEQUENCE;
+    }
+
+    if (length > available || c[1] < low || c[1] > high) {
+        return INVALID_SEQUENCE;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (!is_continuation(c[i])) {
+            return INVALID_SEQUENCE;
+        }
+    }
+    return length;
+}
+
+static size_t char_length(const unsigned char *c, size_t available) {
+    size_t length = sequence_length(c, available);
+    return (length == INVALID_SEQUENCE) ? 1 : length;
+}
+
+static size_t skip_chars(const unsigned char *addr, size_t length, size_t offset, long long count) {
+    while (count > 0 && offset < length) {
+        size_t limit = length - offset;
+        if ((unsigned long long) count < limit) {
+            limit = count;
+        }
+        size_t run = selected_ascii(addr + offset, limit);
+        offset += run;
+        count -= run;
+        if (count == 0 || offset == length) {
+            break;
+        }
+        offset += char_length(addr + offset, length - offset);
+        count--;
+    }
+    return offset;
+}
+
+static int grow_array(void **array, long long *size, long long required, size_t entry_size, long long init_size) {
+    if (required <= *size) {
+        return UTF8_INDEX_SUCCESS;
+    }
+    long long new_size = (*size == 0) ? init_size : *size;
+    while (new_size < required) {
+        new_size *= 2;
+    }
+    void *ptr = realloc(*array, new_size * entry_size);
+    if (ptr == NULL) {
+        perror("Can't grow UTF-8 index");
+        return UTF8_INDEX_ERROR;
+    }
+    *array = ptr;
+    *size = new_size;
+    return UTF8_INDEX_SUCCESS;
+}
+
+static int add_checkpoint(utf8_index *index, off_t offset) {
+    int grow_check = grow_array((void **) &index->checkpoints, &index->checkpoints_size,
+                                index->checkpoints_length + 1, sizeof(off_t), INIT_CHECKPOINTS_SIZE);
+    if (grow_check == UTF8_INDEX_ERROR) {
+        return UTF8_INDEX_ERROR;
+    }
+    index->checkpoints[index->checkpoints_length++] = offset;
+    return UTF8_INDEX_SUCCESS;
+}
+
+static int add_error(utf8_index *index, off_t column) {
+    int grow_check = grow_array((void **) &index->errors, &index->errors_size,
+                                index->errors_length + 1, sizeof(utf8_error), INIT_ERRORS_SIZE);
+    if (grow_check == UTF8_INDEX_ERROR) {
+        return UTF8_INDEX_ERROR;
+    }
+    index->errors[index->errors_length].line = index->length + 1;
+    index->errors[index->errors_length].column = column;
+    index->errors_length++;
+    return UTF8_INDEX_SUCCESS;
+}
+
+utf8_index *utf8_index_create(long long expected_length) {
+    pthread_once(&select_once, select_kernel);
+
+    utf8_index *index = (utf8_index *) calloc(1, sizeof(utf8_index));
+    if (index == NULL) {
+        perror("Can't create UTF-8 index");
+        return NULL;
+    }
+    int grow_check = grow_array((void **) &index->lines, &index->size, expected_length, sizeof(utf8_line), MIN_LINES_SIZE);
+    if (grow_check == UTF8_INDEX_ERROR) {
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+int utf8_index_add_line(utf8_index *index, const char *addr, size_t length) {
+    int grow_check = grow_array((void **) &index->lines, &index->size, index->length + 1, sizeof(utf8_line), MIN_LINES_SIZE);
+    if (grow_check == UTF8_INDEX_ERROR) {
+        return UTF8_INDEX_ERROR;
+    }
+
+    const unsigned char *c = (const unsigned char *) addr;
+    utf8_line *line = &index->lines[index->length];
+    line->first_checkpoint = index->checkpoints_length;
+
+    long long chars = 0, next_checkpoint = UTF8_CHECKPOINT_CHARS;
+    size_t offset = 0;
+    while (offset < length) {
+        size_t run = selected_ascii(c + offset, length - offset);
+        while (next_checkpoint < chars + (long long) run) {
+            if (add_checkpoint(index, offset + (next_checkpoint - chars)) == UTF8_INDEX_ERROR) {
+                return UTF8_INDEX_ERROR;
+            }
+            next_checkpoint += UTF8_CHECKPOINT_CHARS;
+        }
+        chars += run;
+        offset += run;
+        if (offset == length) {
+            break;
+        }
+
+        if (chars == next_checkpoint) {
+            if (add_checkpoint(index, offset) == UTF8_INDEX_ERROR) {
+                return UTF8_INDEX_ERROR;
+            }
+            next_checkpoint += UTF8_CHECKPOINT_CHARS;
+        }
+        size_t sequence = sequence_length(c + offset, length - offset);
+        if (sequence == INVALID_SEQUENCE) {
+            if (add_error(index, offset) == UTF8_INDEX_ERROR) {
+                return UTF8_INDEX_ERROR;
+            }
+            sequence = 1;
+        }
+        chars++;
+        offset += sequence;
+    }
+
+    line->chars = chars;
+    index->length++;
+    return UTF8_INDEX_SUCCESS;
+}
+
+int utf8_index_slice(const utf8_index *index, long long line_num, const char *addr, size_t length,
+                     long long first_column, long long last_column, off_t *slice_offset, size_t *slice_length) {
+    if (index == NULL || line_num < 1 || line_num > index->length) {
+        fprintf(stderr, "Can't slice line: Invalid argument(s)\n");
+        return UTF8_INDEX_ERROR;
+    }
+    const utf8_line *line = &index->lines[line_num - 1];
+    if (first_column < 1 || last_column > line->chars || first_column > last_column) {
+        return UTF8_INDEX_OUT_OF_RANGE;
+    }
+
+    long long first_char = first_column - 1;
+    long long checkpoint = first_char / UTF8_CHECKPOINT_CHARS;
+    size_t begin = (checkpoint == 0) ? 0 : index->checkpoints[line->first_checkpoint + checkpoint - 1];
+    const unsigned char *c = (const unsigned char *) addr;
+
+    begin = skip_chars(c, length, begin, first_char - checkpoint * UTF8_CHECKPOINT_CHARS);
+    size_t end = skip_chars(c, length, begin, last_column - first_column + 1);
+    *slice_offset = begin;
+    *slice_length = end - begin;
+    return UTF8_INDEX_SUCCESS;
+}
+
+size_t utf8_index_bytes(const utf8_index *index) {
+    return index->length * sizeof(utf8_line) + index->checkpoints_length * sizeof(off_t)
+        + index->errors_length * sizeof(utf8_error);
+}
+
+void utf8_index_destroy(utf8_index *index) {
+    if (index == NULL) {
+        return;
+    }
+    free(index->lines);
+    free(index->checkpoints);
+    free(index->errors);
+    free(index);
+}
+
+const char *utf8_scan_kernel() {
+    pthread_once(&select_once, select_kernel);
+    return selected_name;
+}
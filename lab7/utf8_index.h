@@ -0,0 +1,43 @@
+#ifndef LAB7_UTF8_INDEX_H
+#define LAB7_UTF8_INDEX_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+#define UTF8_INDEX_ERROR -1
+#define UTF8_INDEX_SUCCESS 0
+#define UTF8_INDEX_OUT_OF_RANGE 1
+
+#define UTF8_CHECKPOINT_CHARS 1024
+
+typedef struct utf8_line {
+    long long chars;
+    long long first_checkpoint;
+} utf8_line;
+
+typedef struct utf8_error {
+    long long line;
+    off_t column;
+} utf8_error;
+
+typedef struct utf8_index {
+    utf8_line *lines;
+    long long length;
+    long long size;
+    off_t *checkpoints;
+    long long checkpoints_length;
+    long long checkpoints_size;
+    utf8_error *errors;
+    long long errors_length;
+    long long errors_size;
+} utf8_index;
+
+utf8_index *utf8_index_create(long long expected_length);
+int utf8_index_add_line(utf8_index *index, const char *addr, size_t length);
+int utf8_index_slice(const utf8_index *index, long long line_num, const char *addr, size_t length,
+                     long long first_column, long long last_column, off_t *slice_offset, size_t *slice_length);
+size_t utf8_index_bytes(const utf8_index *index);
+void utf8_index_destroy(utf8_index *index);
+const char *utf8_scan_kernel();
+
+#endif